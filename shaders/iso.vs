@@ -1,8 +1,26 @@
 #version 460 core
 
 layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in uint color_id;
+
+uniform mat4 uMVP;
+uniform mat4 uM;
+uniform bool uApplyColor;
+uniform vec3 uPalette[4]; // MAX_COLORS
+
+layout (location = 0) out vec3 a_normal;
+layout (location = 1) out vec3 a_frag_pos;
+layout (location = 2) out vec3 a_color;
 
-layout (location = 0) out vec3 voxel_pos;
 void main() {
-    voxel_pos = position;
+    gl_Position = uMVP * vec4(position, 1.0);
+    a_normal = mat3(uM) * normal;
+    a_frag_pos = (uM * vec4(position, 1.0)).xyz;
+    if (uApplyColor) {
+        a_color = uPalette[color_id];
+    }
+    else {
+        a_color = vec3(1.0, 0.0, 0.0);
+    }
 }
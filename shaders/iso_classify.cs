@@ -0,0 +1,59 @@
+#version 460 core
+
+// One brick of cells per work group
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
+const uint brick_cells = 512;
+
+layout(std430, binding = 0) buffer Tri_Table {
+    int tri_table[];
+};
+
+// Triangles of each cell of the active bricks, scanned into the triangles before it afterwards
+layout(std430, binding = 2) buffer Counts {
+    uint counts[];
+};
+
+// Bricks the surface passes through, as indices into the bricks of the grid
+layout(std430, binding = 6) buffer Bricks {
+    uint bricks[];
+};
+
+uniform usampler3D field_tex;
+uniform uvec3 uDims;
+uniform int uThreshold;
+uniform uvec3 uBricks;
+uniform uint uBrickCount;
+
+bool inside(ivec3 p) {
+    return int(texelFetch(field_tex, p, 0).r) <= uThreshold;
+}
+
+void main() {
+    // Groups past the dispatch limit along x continue along y
+    uint group = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    if (group >= uBrickCount) {
+        return;
+    }
+
+    // Bricks on the far faces of the grid are cut short, their missing cells have no triangles
+    uint slot = group * brick_cells + gl_LocalInvocationIndex;
+    uint brick = bricks[group];
+    uvec3 cell = uvec3(brick % uBricks.x, (brick / uBricks.x) % uBricks.y, brick / (uBricks.x * uBricks.y)) *
+        gl_WorkGroupSize + gl_LocalInvocationID;
+    if (any(greaterThanEqual(cell, uDims - 1))) {
+        counts[slot] = 0;
+        return;
+    }
+
+    ivec3 p = ivec3(cell);
+    int bitmask = 0;
+    for (int idx = 0; idx < 8; idx++) {
+        bitmask |= ((inside(p + ivec3(idx & 1, (idx >> 1) & 1, idx >> 2)) ? 1 : 0) << idx);
+    }
+
+    uint count = 0;
+    while (count < 5 && tri_table[bitmask * 16 + count * 3] != -1) {
+        count++;
+    }
+    counts[slot] = count;
+}
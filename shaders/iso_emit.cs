@@ -0,0 +1,128 @@
+#version 460 core
+
+// One brick of cells per work group
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
+const uint brick_cells = 512;
+
+const int edge_vertex_indices[24] = {
+    0, 1, 1, 3, 3, 2, 2, 0, 4, 5, 5, 7,
+    7, 6, 6, 4, 0, 4, 1, 5, 3, 7, 2, 6
+};
+
+layout(std430, binding = 0) buffer Tri_Table {
+    int tri_table[];
+};
+
+// Triangles before each cell of the active bricks
+layout(std430, binding = 2) buffer Offsets {
+    uint offsets[];
+};
+
+// 7 words per vertex, laid out as IsoVertex: position, normal and colour index
+layout(std430, binding = 4) buffer Vertices {
+    float vertices[];
+};
+
+// DrawArraysIndirectCommand
+layout(std430, binding = 5) buffer Command {
+    uint command[4];
+};
+
+layout(std430, binding = 6) buffer Bricks {
+    uint bricks[];
+};
+
+uniform usampler3D field_tex;
+uniform usampler3D color_tex;
+uniform uvec3 uDims;
+uniform int uThreshold;
+uniform uvec3 uBricks;
+uniform uint uBrickCount;
+uniform float uIsoValue;
+uniform vec3 uOrigin;
+uniform vec3 uStep;
+
+float value(ivec3 p) {
+    return float(texelFetch(field_tex, p, 0).r);
+}
+
+// Central differences inside the grid and one sided ones on its faces, in object space
+vec3 gradient(ivec3 p) {
+    ivec3 lo = max(p - 1, ivec3(0));
+    ivec3 hi = min(p + 1, ivec3(uDims) - 1);
+    vec3 span = max(vec3(hi - lo), vec3(1.0)) * uStep;
+    return vec3(
+        value(ivec3(hi.x, p.y, p.z)) - value(ivec3(lo.x, p.y, p.z)),
+        value(ivec3(p.x, hi.y, p.z)) - value(ivec3(p.x, lo.y, p.z)),
+        value(ivec3(p.x, p.y, hi.z)) - value(ivec3(p.x, p.y, lo.z))) / span;
+}
+
+void main() {
+    uint group = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    if (group >= uBrickCount) {
+        return;
+    }
+
+    uint slot = group * brick_cells + gl_LocalInvocationIndex;
+    uint brick = bricks[group];
+    uvec3 cell = uvec3(brick % uBricks.x, (brick / uBricks.x) % uBricks.y, brick / (uBricks.x * uBricks.y)) *
+        gl_WorkGroupSize + gl_LocalInvocationID;
+    bool in_grid = all(lessThan(cell, uDims - 1));
+
+    ivec3 p = ivec3(cell);
+    ivec3 corners[8];
+    float scalars[8];
+    int bitmask = 0;
+    for (int idx = 0; idx < 8 && in_grid; idx++) {
+        corners[idx] = p + ivec3(idx & 1, (idx >> 1) & 1, idx >> 2);
+        scalars[idx] = value(corners[idx]);
+        bitmask |= ((int(scalars[idx]) <= uThreshold ? 1 : 0) << idx);
+    }
+
+    // Cells past the far faces of the grid were counted without triangles
+    uint count = 0;
+    while (in_grid && count < 5 && tri_table[bitmask * 16 + count * 3] != -1) {
+        count++;
+    }
+
+    // The last slot knows how many triangles there are in all
+    if (slot == uBrickCount * brick_cells - 1) {
+        command[0] = 3 * (offsets[slot] + count);
+        command[1] = 1;
+        command[2] = 0;
+        command[3] = 0;
+    }
+
+    uint out_idx = 3 * offsets[slot];
+    for (uint v = 0; v < 3 * count; v++) {
+        int edge = tri_table[bitmask * 16 + v];
+        int v0_idx = edge_vertex_indices[edge * 2];
+        int v1_idx = edge_vertex_indices[edge * 2 + 1];
+        float t = (uIsoValue - scalars[v0_idx]) / (scalars[v1_idx] - scalars[v0_idx]);
+        vec3 position = uOrigin + mix(vec3(corners[v0_idx]), vec3(corners[v1_idx]), t) * uStep;
+
+        // Triangles face down the field, towards the traits, and so do the normals
+        vec3 normal = -mix(gradient(corners[v0_idx]), gradient(corners[v1_idx]), t);
+        // Where the gradient vanishes, the edge itself is the best guess
+        float len = length(normal);
+        if (len > 0.0) {
+            normal /= len;
+        }
+        else {
+            normal = scalars[v0_idx] < scalars[v1_idx] ? vec3(corners[v0_idx] - corners[v1_idx]) :
+                vec3(corners[v1_idx] - corners[v0_idx]);
+        }
+
+        int inner = int(scalars[v0_idx]) <= uThreshold ? v0_idx : v1_idx;
+        uint color_id = texelFetch(color_tex, corners[inner], 0).r;
+
+        uint base = 7 * (out_idx + v);
+        vertices[base] = position.x;
+        vertices[base + 1] = position.y;
+        vertices[base + 2] = position.z;
+        vertices[base + 3] = normal.x;
+        vertices[base + 4] = normal.y;
+        vertices[base + 5] = normal.z;
+        vertices[base + 6] = uintBitsToFloat(color_id);
+    }
+}
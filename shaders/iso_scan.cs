@@ -0,0 +1,45 @@
+#version 460 core
+
+// Each group scans a block of 1024 values, 2 per invocation
+layout (local_size_x = 512) in;
+
+// Replaced by the sum of the values before each one within its block
+layout(std430, binding = 2) buffer Values {
+    uint values[];
+};
+
+layout(std430, binding = 3) buffer Block_Sums {
+    uint block_sums[];
+};
+
+uniform uint uCount;
+
+shared uint partial[512];
+
+void main() {
+    uint block = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    uint local = gl_LocalInvocationID.x;
+    uint first = block * 1024 + 2 * local;
+    uint a = first < uCount ? values[first] : 0;
+    uint b = first + 1 < uCount ? values[first + 1] : 0;
+
+    partial[local] = a + b;
+    barrier();
+    for (uint offset = 1; offset < 512; offset <<= 1) {
+        uint add = local >= offset ? partial[local - offset] : 0;
+        barrier();
+        partial[local] += add;
+        barrier();
+    }
+
+    uint before = partial[local] - a - b;
+    if (first < uCount) {
+        values[first] = before;
+    }
+    if (first + 1 < uCount) {
+        values[first + 1] = before + a;
+    }
+    if (local == 511 && block * 1024 < uCount) {
+        block_sums[block] = partial[511];
+    }
+}
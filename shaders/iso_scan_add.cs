@@ -0,0 +1,25 @@
+#version 460 core
+
+// Adds the scanned sum of the blocks before each block of 1024 values to its values
+layout (local_size_x = 512) in;
+
+layout(std430, binding = 2) buffer Values {
+    uint values[];
+};
+
+layout(std430, binding = 3) buffer Block_Sums {
+    uint block_sums[];
+};
+
+uniform uint uCount;
+
+void main() {
+    uint block = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    uint first = block * 1024 + 2 * gl_LocalInvocationID.x;
+    if (first < uCount) {
+        values[first] += block_sums[block];
+    }
+    if (first + 1 < uCount) {
+        values[first + 1] += block_sums[block];
+    }
+}
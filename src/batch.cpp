@@ -0,0 +1,439 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <charconv>
+#include <variant>
+#include <stdexcept>
+#include "batch.h"
+#include "vtk.h"
+#include "attrib.h"
+#include "distance_field.h"
+#include "parallel.h"
+
+namespace MVF {
+    // Just enough JSON for trait files: objects keep their members in order, numbers are doubles
+    struct JsonValue {
+        using Array = std::vector<JsonValue>;
+        using Object = std::vector<std::pair<std::string, JsonValue>>;
+        std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+    };
+
+    class JsonReader {
+    public:
+        explicit JsonReader(const std::string& text) : text(text) {}
+
+        JsonValue parse() {
+            auto value = parse_value();
+            skip_space();
+            if (pos != text.size()) {
+                fail("trailing characters");
+            }
+            return value;
+        }
+
+    private:
+        const std::string& text;
+        size_t pos = 0;
+
+        [[noreturn]] void fail(const std::string& what) const {
+            throw std::runtime_error("JSON: " + what + " at offset " + std::to_string(pos));
+        }
+
+        void skip_space() {
+            while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+                pos++;
+            }
+        }
+
+        bool consume(char c) {
+            skip_space();
+            if (pos < text.size() && text[pos] == c) {
+                pos++;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(char c) {
+            if (!consume(c)) {
+                fail(std::string("expected '") + c + "'");
+            }
+        }
+
+        bool consume_word(const std::string& word) {
+            if (text.compare(pos, word.size(), word) == 0) {
+                pos += word.size();
+                return true;
+            }
+            return false;
+        }
+
+        JsonValue parse_value() {
+            skip_space();
+            if (pos == text.size()) {
+                fail("unexpected end");
+            }
+
+            switch (text[pos]) {
+                case '{': return parse_object();
+                case '[': return parse_array();
+                case '"': return {parse_string()};
+            }
+            if (consume_word("true")) {
+                return {true};
+            }
+            if (consume_word("false")) {
+                return {false};
+            }
+            if (consume_word("null")) {
+                return {nullptr};
+            }
+
+            double number;
+            auto [next, ec] = std::from_chars(text.data() + pos, text.data() + text.size(), number);
+            if (ec != std::errc()) {
+                fail("invalid value");
+            }
+            pos = next - text.data();
+            return {number};
+        }
+
+        std::string parse_string() {
+            expect('"');
+            std::string out;
+            while (pos < text.size() && text[pos] != '"') {
+                char c = text[pos++];
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (pos == text.size()) {
+                    break;
+                }
+                switch (char e = text[pos++]) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': fail("\\u escapes are not supported");
+                    default: out += e; break;
+                }
+            }
+            if (pos == text.size()) {
+                fail("unterminated string");
+            }
+            pos++;
+            return out;
+        }
+
+        JsonValue parse_array() {
+            expect('[');
+            JsonValue::Array items;
+            if (consume(']')) {
+                return {std::move(items)};
+            }
+            do {
+                items.push_back(parse_value());
+            } while (consume(','));
+            expect(']');
+            return {std::move(items)};
+        }
+
+        JsonValue parse_object() {
+            expect('{');
+            JsonValue::Object members;
+            if (consume('}')) {
+                return {std::move(members)};
+            }
+            do {
+                skip_space();
+                auto key = parse_string();
+                expect(':');
+                members.emplace_back(std::move(key), parse_value());
+            } while (consume(','));
+            expect('}');
+            return {std::move(members)};
+        }
+    };
+
+    static const JsonValue& json_member(const JsonValue& object, const std::string& key) {
+        if (auto members = std::get_if<JsonValue::Object>(&object.value)) {
+            for (auto& [name, value] : *members) {
+                if (name == key) {
+                    return value;
+                }
+            }
+        }
+        throw std::runtime_error("Missing \"" + key + "\" in trait file");
+    }
+
+    static const JsonValue::Array& json_array(const JsonValue& value, const std::string& what) {
+        if (auto items = std::get_if<JsonValue::Array>(&value.value)) {
+            return *items;
+        }
+        throw std::runtime_error(what + " must be an array");
+    }
+
+    static const std::string& json_string(const JsonValue& value, const std::string& what) {
+        if (auto text = std::get_if<std::string>(&value.value)) {
+            return *text;
+        }
+        throw std::runtime_error(what + " must be a string");
+    }
+
+    static float json_number(const JsonValue& value, const std::string& what) {
+        if (auto number = std::get_if<double>(&value.value)) {
+            return static_cast<float>(*number);
+        }
+        throw std::runtime_error(what + " must be a number");
+    }
+
+    // An array of exactly count numbers
+    static std::vector<float> json_numbers(const JsonValue& value, size_t count, const std::string& what) {
+        auto& items = json_array(value, what);
+        if (items.size() != count) {
+            throw std::runtime_error(what + " must have " + std::to_string(count) + " values");
+        }
+        std::vector<float> numbers;
+        for (auto& item : items) {
+            numbers.push_back(json_number(item, what));
+        }
+        return numbers;
+    }
+
+    static Trait read_trait(const JsonValue& entry, size_t dims) {
+        auto& type = json_string(json_member(entry, "type"), "Trait type");
+        auto color = json_number(json_member(entry, "color"), "Trait color");
+        if (color < 0 || color >= MAX_COLORS) {
+            throw std::runtime_error("Trait colors go from 0 to " + std::to_string(MAX_COLORS - 1));
+        }
+
+        Trait trait;
+        trait.color_id = static_cast<size_t>(color);
+        if (type == "point") {
+            trait.type = TraitType::PARALLEL_POINT;
+            trait.data = NDPoint{json_numbers(json_member(entry, "at"), dims, "Point coordinates")};
+        }
+        else if (type == "interval") {
+            if (dims != 1) {
+                throw std::runtime_error("Intervals need a single component");
+            }
+            auto range = json_numbers(json_member(entry, "range"), 2, "Interval range");
+            trait.type = TraitType::RANGE;
+            trait.data = Range{RangeType::INTERVAL, Interval{std::min(range[0], range[1]), std::max(range[0], range[1]), {}}};
+        }
+        else if (type == "polygon") {
+            if (dims != 2) {
+                throw std::runtime_error("Polygons need two components");
+            }
+            auto lo = json_numbers(json_member(entry, "min"), 2, "Polygon min");
+            auto hi = json_numbers(json_member(entry, "max"), 2, "Polygon max");
+            trait.type = TraitType::RANGE;
+            trait.data = Range{RangeType::POLYGON, Polygon{std::min(lo[0], hi[0]), std::min(lo[1], hi[1]),
+                std::abs(hi[0] - lo[0]), std::abs(hi[1] - lo[1]), {}}};
+        }
+        else if (type == "box") {
+            auto& ranges = json_array(json_member(entry, "ranges"), "Box ranges");
+            if (ranges.size() != dims) {
+                throw std::runtime_error("Box ranges must have one range per component");
+            }
+            HyperBox box;
+            for (auto& range : ranges) {
+                auto bounds = json_numbers(range, 2, "Box range");
+                box.yranges.emplace_back(std::min(bounds[0], bounds[1]), std::max(bounds[0], bounds[1]));
+            }
+            trait.type = TraitType::RANGE;
+            trait.data = Range{RangeType::HYPERBOX, box};
+        }
+        else {
+            throw std::runtime_error("Unknown trait type " + type);
+        }
+        return trait;
+    }
+
+    struct BatchArgs {
+        std::string volume, trait_file, out = "field";
+        size_t threads = 0, repeat = 1;
+        bool lookup_table = false;
+    };
+
+    static BatchArgs parse_batch_args(int argc, char* argv[]) {
+        BatchArgs args;
+        std::vector<std::string> positional;
+        auto count = [&] (int& i, const std::string& flag) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(flag + " needs a value");
+            }
+            size_t value;
+            std::string text = argv[++i];
+            auto [next, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (ec != std::errc() || next != text.data() + text.size()) {
+                throw std::runtime_error(flag + " needs a number");
+            }
+            return value;
+        };
+
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--out") {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error(arg + " needs a value");
+                }
+                args.out = argv[++i];
+            }
+            else if (arg == "--threads") {
+                args.threads = count(i, arg);
+            }
+            else if (arg == "--repeat") {
+                args.repeat = std::max<size_t>(1, count(i, arg));
+            }
+            else if (arg == "--lookup-table") {
+                args.lookup_table = true;
+            }
+            else if (arg.starts_with("--")) {
+                throw std::runtime_error("Unknown option " + arg);
+            }
+            else {
+                positional.push_back(arg);
+            }
+        }
+
+        if (positional.size() != 2) {
+            throw std::runtime_error("Usage: mvf --batch <volume> <traits.json> [--out <prefix>] [--threads <n>] "
+                "[--repeat <n>] [--lookup-table]");
+        }
+        args.volume = positional[0];
+        args.trait_file = positional[1];
+        return args;
+    }
+
+    // Opens the volume and brings the named components into memory
+    static std::shared_ptr<VolumeData> load_volume(const std::string& filename, const std::vector<std::string>& comps) {
+        auto loader = open_volume_async(filename);
+        if (loader->read_failed) {
+            throw std::runtime_error("File format of " + filename + " not supported");
+        }
+
+        loader->load();
+        loader->complete();
+        if (loader->read_failed) {
+            throw std::runtime_error("Unable to read " + filename);
+        }
+        std::cout << "Opened " << filename << ": " << loader->stats.summary() << std::endl;
+
+        if (loader->load_fields(comps)) {
+            loader->complete();
+            if (loader->read_failed) {
+                throw std::runtime_error("Unable to load the components of " + filename);
+            }
+            std::cout << "Loaded fields of " << filename << ": " << loader->stats.summary() << std::endl;
+        }
+        loader->finish_cache();
+        return loader->data;
+    }
+
+    template <typename T>
+    static void write_raw(const std::string& filename, const std::vector<T>& values) {
+        std::ofstream file(filename, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        if (!file) {
+            throw std::runtime_error("Unable to write " + filename);
+        }
+    }
+
+    static int batch(int argc, char* argv[]) {
+        auto args = parse_batch_args(argc, argv);
+        worker_count = args.threads;
+
+        std::string text;
+        if (!read_file(args.trait_file, text)) {
+            throw std::runtime_error("Unable to read " + args.trait_file);
+        }
+        auto spec = JsonReader(text).parse();
+
+        std::vector<std::string> comps;
+        for (auto& comp : json_array(json_member(spec, "components"), "Components")) {
+            comps.push_back(json_string(comp, "Component"));
+        }
+        if (comps.empty()) {
+            throw std::runtime_error("At least one attribute component required");
+        }
+
+        std::vector<Trait> traits;
+        for (auto& entry : json_array(json_member(spec, "traits"), "Traits")) {
+            traits.push_back(read_trait(entry, comps.size()));
+        }
+        if (traits.empty()) {
+            throw std::runtime_error("At least one trait required");
+        }
+
+        auto data = load_volume(args.volume, comps);
+        std::vector<AxisDescMeta> attrib_comps;
+        for (auto& comp : comps) {
+            auto it = data->scalars.find(comp);
+            if (it == data->scalars.end()) {
+                throw std::runtime_error(args.volume + " has no component " + comp);
+            }
+            float min_val, max_val;
+            if (auto range = data->ranges.find(comp); range != data->ranges.end()) {
+                std::tie(min_val, max_val) = range->second;
+            }
+            else {
+                std::tie(min_val, max_val) = it->second.minmax();
+            }
+            attrib_comps.push_back(AxisDescMeta{.desc = {comp, comp, nullptr}, .min_val = min_val, .max_val = max_val});
+        }
+
+        std::cout << "Computing the distance field of " << data->nx << "x" << data->ny << "x" << data->nz << " voxels to "
+            << traits.size() << " traits over " << comps.size() << " components with " << default_workers()
+            << " threads" << std::endl;
+
+        // Every run starts from an empty state, so none of them is a cheap incremental update
+        DistanceOptions options;
+        options.lookup_table = args.lookup_table;
+        std::vector<uint16_t> field;
+        std::vector<uint8_t> color_ids;
+        std::atomic<bool> stop = false;
+        double best = 0, total = 0;
+        for (size_t run = 0; run < args.repeat; run++) {
+            DistanceState state;
+            DistanceReport report;
+            compute_distance_field(data, attrib_comps, traits, field, color_ids, state, options, report, stop, nullptr);
+            std::cout << "Distance field " << report.summary() << std::endl;
+            best = run ? std::min(report.seconds, best) : report.seconds;
+            total += report.seconds;
+        }
+        if (args.repeat > 1) {
+            std::cout << std::fixed << std::setprecision(3) << "Best of " << args.repeat << " runs " << best
+                << " s, mean " << total / args.repeat << " s" << std::endl;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::ostringstream dims;
+        dims << data->nx << "x" << data->ny << "x" << data->nz;
+        auto field_file = args.out + "_" + dims.str() + "_uint16.raw";
+        auto color_file = args.out + "_colors_" + dims.str() + "_uint8.raw";
+        write_raw(field_file, field);
+        write_raw(color_file, color_ids);
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::fixed << std::setprecision(2) << "Wrote " << field_file << " and " << color_file << " in "
+            << seconds << " s" << std::endl;
+        return 0;
+    }
+
+    int run_batch(int argc, char* argv[]) {
+        try {
+            return batch(argc, argv);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,1676 @@
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include "distance_field.h"
+#include "parallel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MVF_X86_SIMD
+// The vector kernels do the same operations in the same order per lane as the scalar ones, so all of them
+// agree bit for bit. That also means keeping the compiler from fusing their multiplies and adds, as AVX-512
+// implies FMA. Helpers carry the same attributes as the kernels so they can be inlined into them.
+#define MVF_AVX2 __attribute__((target("avx2"), optimize("fp-contract=off")))
+#define MVF_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#endif
+
+// Voxels handed to a worker at a time (rounded to whole rows), also the granularity of cancellation checks
+constexpr size_t DIST_SLAB_VOXELS = 1 << 16;
+// Voxels whose attribute tuples are converted to float together before the kernels run over them
+constexpr size_t DIST_BLOCK_VOXELS = 1024;
+// From this many traits on, voxels search a bounding volume hierarchy over them instead of visiting every one.
+// Wider vectors make visiting every trait cheaper, so the crossover is later for them.
+constexpr size_t DIST_INDEX_MIN_TRAITS_SCALAR = 256;
+constexpr size_t DIST_INDEX_MIN_TRAITS_AVX2 = 1024;
+constexpr size_t DIST_INDEX_MIN_TRAITS_AVX512 = 2048;
+// Traits per leaf of that hierarchy
+constexpr size_t DIST_INDEX_LEAF_TRAITS = 4;
+// Box distances are only a bound up to rounding, subtrees are skipped once they are clearly past the runner up
+constexpr float DIST_INDEX_SLACK = 1e-5f;
+// Nodes per axis of an attribute space lookup table, by number of components
+constexpr size_t DIST_LUT_NODES[] = {0, 4096, 512, 64};
+// Voxels a lookup table is checked against the exact distances at
+constexpr size_t DIST_LUT_SAMPLES = 1 << 16;
+// Voxels checked for repeated attribute tuples before a build decides whether to rank each distinct tuple once
+constexpr size_t DIST_UNIQUE_SAMPLES = 1 << 16;
+// Voxels each distinct tuple has to stand for, on average, for that to be worth it
+constexpr size_t DIST_UNIQUE_MIN_REUSE = 4;
+// Finding a voxel's tuple costs about as much as ranking a few dozen traits with the vector kernels, fewer
+// traits than this are cheaper to rank at every voxel
+constexpr size_t DIST_UNIQUE_MIN_TRAITS = 32;
+// Keeps the table of distinct tuples to a few tens of MB
+constexpr size_t DIST_UNIQUE_MAX_TUPLES = 1 << 20;
+// Most voxels in the first preview of a coarse to fine build, small enough to be ranked well within a second
+constexpr size_t DIST_PREVIEW_VOXELS = 1 << 18;
+
+namespace MVF {
+    enum class DistanceIsa {
+        SCALAR,
+        AVX2,
+        AVX512
+    };
+
+    static DistanceIsa distance_isa() {
+#ifdef MVF_X86_SIMD
+        static const bool has_avx512 = __builtin_cpu_supports("avx512f");
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        if (has_avx512) {
+            return DistanceIsa::AVX512;
+        }
+        if (has_avx2) {
+            return DistanceIsa::AVX2;
+        }
+#endif
+        return DistanceIsa::SCALAR;
+    }
+
+    enum class TraitKind {
+        POINT_1D,
+        POINT_2D,
+        ND_POINT,
+        INTERVAL,
+        POLYGON,
+        HYPERBOX,
+        COUNT
+    };
+
+    // A trait flattened into what its distance needs, so the kernels don't go through the variants. For
+    // polygons p holds the bounds and the centre, for intervals the two ends, for points the coordinates.
+    struct TraitParams {
+        uint32_t index; // Position in the trait list, which decides ties
+        float p[6];
+        std::vector<float> lo, hi; // Per axis coordinates (n-d points) or bounds (hyperboxes)
+    };
+
+    struct ResolvedTrait {
+        TraitKind kind;
+        TraitParams params;
+
+        // Same geometry in attribute space, so the same distance at every voxel
+        bool operator==(const ResolvedTrait& other) const {
+            return kind == other.kind && std::equal(params.p, params.p + 6, other.params.p)
+                && params.lo == other.params.lo && params.hi == other.params.hi;
+        }
+    };
+
+    struct TraitIndex;
+
+    // Traits grouped by kind. Kernels go over one group at a time with the distance of that kind inlined,
+    // so there is no branching on the trait type inside the voxel loops. Large sets also get an index.
+    struct TraitSet {
+        std::vector<TraitParams> kinds[static_cast<size_t>(TraitKind::COUNT)];
+        std::shared_ptr<const TraitIndex> index;
+
+        void add(const ResolvedTrait& trait) {
+            kinds[static_cast<size_t>(trait.kind)].push_back(trait.params);
+        }
+
+        const std::vector<TraitParams>& of(TraitKind kind) const {
+            return kinds[static_cast<size_t>(kind)];
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        size_t size() const {
+            size_t count = 0;
+            for (auto& group : kinds) {
+                count += group.size();
+            }
+            return count;
+        }
+    };
+
+    static ResolvedTrait resolve_trait(const Trait& trait, uint32_t index, size_t dims) {
+        TraitParams params{};
+        params.index = index;
+        TraitKind kind{};
+        switch (trait.type) {
+            case TraitType::POINT: {
+                auto& tr_pt = std::get<Point>(trait.data);
+                kind = dims == 1 ? TraitKind::POINT_1D : TraitKind::POINT_2D;
+                params.p[0] = tr_pt.x;
+                params.p[1] = tr_pt.y;
+                break;
+            }
+            case TraitType::PARALLEL_POINT: {
+                auto& nd = std::get<NDPoint>(trait.data);
+                kind = TraitKind::ND_POINT;
+                params.lo.assign(nd.ys.begin(), nd.ys.begin() + std::min(nd.ys.size(), dims));
+                break;
+            }
+            case TraitType::RANGE: {
+                auto& r = std::get<Range>(trait.data);
+                if (r.type == RangeType::INTERVAL) {
+                    auto& tr_int = std::get<Interval>(r.range);
+                    kind = TraitKind::INTERVAL;
+                    params.p[0] = tr_int.left;
+                    params.p[1] = tr_int.right;
+                }
+                else if (r.type == RangeType::POLYGON) {
+                    // Outside the rectangle the distance is measured to its centre
+                    auto& tr_poly = std::get<Polygon>(r.range);
+                    kind = TraitKind::POLYGON;
+                    params.p[0] = tr_poly.x_top;
+                    params.p[1] = tr_poly.x_top + tr_poly.width;
+                    params.p[2] = tr_poly.y_top;
+                    params.p[3] = tr_poly.y_top + tr_poly.height;
+                    params.p[4] = tr_poly.x_top + tr_poly.width / 2;
+                    params.p[5] = tr_poly.y_top + tr_poly.height / 2;
+                }
+                else {
+                    auto& hb = std::get<HyperBox>(r.range);
+                    kind = TraitKind::HYPERBOX;
+                    for (size_t a = 0; a < std::min(hb.yranges.size(), dims); a++) {
+                        params.lo.push_back(std::min(hb.yranges[a].first, hb.yranges[a].second));
+                        params.hi.push_back(std::max(hb.yranges[a].first, hb.yranges[a].second));
+                    }
+                }
+                break;
+            }
+        }
+
+        return {kind, std::move(params)};
+    }
+
+    // Axes an n-d trait spans, known at compile time unless Dims is 0
+    template <size_t Dims>
+    static inline size_t trait_axes(const TraitParams& tr) {
+        if constexpr (Dims != 0) {
+            return Dims;
+        }
+        else {
+            return tr.lo.size();
+        }
+    }
+
+    // Traits are ranked by distance, then by their position in the list. They are visited by kind rather
+    // than in list order, this keeps the winner the same as a walk over the list would give.
+    static inline bool ranks_before(float dist, uint32_t index, float other_dist, uint32_t other_index) {
+        return dist < other_dist || (dist == other_dist && index < other_index);
+    }
+
+    // The two best ranked traits of a voxel. The runner up is what lets the field be updated when the
+    // winner is removed without going over all the traits again.
+    struct RankedTraits {
+        float dist = INFINITY, second_dist = INFINITY;
+        uint32_t trait = 0, second_trait = 0;
+    };
+
+    static inline void rank_trait(RankedTraits& r, float dist, uint32_t index) {
+        if (ranks_before(dist, index, r.dist, r.trait)) {
+            r.second_dist = r.dist;
+            r.second_trait = r.trait;
+            r.dist = dist;
+            r.trait = index;
+        }
+        else if (ranks_before(dist, index, r.second_dist, r.second_trait)) {
+            r.second_dist = dist;
+            r.second_trait = index;
+        }
+    }
+
+    // Where the kernels write their results, indexed like the voxels of the block they are given
+    struct RankedOutput {
+        float* dist;
+        float* second_dist;
+        uint32_t* trait;
+        uint32_t* second_trait;
+
+        RankedTraits get(size_t i) const {
+            return {dist[i], second_dist[i], trait[i], second_trait[i]};
+        }
+
+        void set(size_t i, const RankedTraits& r) const {
+            dist[i] = r.dist;
+            second_dist[i] = r.second_dist;
+            trait[i] = r.trait;
+            second_trait[i] = r.second_trait;
+        }
+
+        RankedOutput operator+(size_t offset) const {
+            return {dist + offset, second_dist + offset, trait + offset, second_trait + offset};
+        }
+    };
+
+    // Attribute tuples of a block are stored per component: pts[dim * stride + voxel]
+    template <TraitKind Kind, size_t Dims>
+    static inline float trait_distance(const TraitParams& tr, const float* pts, size_t stride, size_t i) {
+        auto pt = [pts, stride, i] (size_t dim) { return pts[dim * stride + i]; };
+        if constexpr (Kind == TraitKind::POINT_1D) {
+            return (tr.p[0] - pt(0)) * (tr.p[0] - pt(0));
+        }
+        else if constexpr (Kind == TraitKind::POINT_2D) {
+            return (tr.p[1] - pt(1)) * (tr.p[1] - pt(1)) + (tr.p[0] - pt(0)) * (tr.p[0] - pt(0));
+        }
+        else if constexpr (Kind == TraitKind::ND_POINT) {
+            float dsum = 0.0f;
+            for (size_t a = 0; a < trait_axes<Dims>(tr); a++) {
+                float d = tr.lo[a] - pt(a);
+                dsum += d * d;
+            }
+            return dsum;
+        }
+        else if constexpr (Kind == TraitKind::INTERVAL) {
+            if (pt(0) >= tr.p[0] && pt(0) <= tr.p[1]) {
+                return 0;
+            }
+            float d = std::min(std::abs(tr.p[0] - pt(0)), std::abs(tr.p[1] - pt(0)));
+            return d * d;
+        }
+        else if constexpr (Kind == TraitKind::POLYGON) {
+            if (pt(0) >= tr.p[0] && pt(0) <= tr.p[1] && pt(1) >= tr.p[2] && pt(1) <= tr.p[3]) {
+                return 0;
+            }
+            return (tr.p[5] - pt(1)) * (tr.p[5] - pt(1)) + (tr.p[4] - pt(0)) * (tr.p[4] - pt(0));
+        }
+        else {
+            float dsum = 0.0f;
+            for (size_t a = 0; a < trait_axes<Dims>(tr); a++) {
+                if (pt(a) < tr.lo[a]) {
+                    float d = tr.lo[a] - pt(a);
+                    dsum += d * d;
+                }
+                else if (pt(a) > tr.hi[a]) {
+                    float d = pt(a) - tr.hi[a];
+                    dsum += d * d;
+                }
+            }
+            return dsum;
+        }
+    }
+
+    template <TraitKind Kind, size_t Dims>
+    static inline void nearest_of_kind(const TraitSet& set, const float* pts, size_t stride, size_t i,
+        RankedTraits& ranked) {
+        for (auto& tr : set.of(Kind)) {
+            rank_trait(ranked, trait_distance<Kind, Dims>(tr, pts, stride, i), tr.index);
+        }
+    }
+
+    // The kernels rank the traits for every voxel of [first, count) in a block, writing the squared distance
+    // and index of the best two. The vector ones return how many voxels they handled, the rest is left to the
+    // scalar one.
+    template <size_t Dims>
+    static void nearest_trait_scalar(const TraitSet& set, const float* pts, size_t stride, size_t first,
+        size_t count, const RankedOutput& out) {
+        for (size_t i = first; i < count; i++) {
+            RankedTraits ranked;
+            nearest_of_kind<TraitKind::POINT_1D, Dims>(set, pts, stride, i, ranked);
+            nearest_of_kind<TraitKind::POINT_2D, Dims>(set, pts, stride, i, ranked);
+            nearest_of_kind<TraitKind::ND_POINT, Dims>(set, pts, stride, i, ranked);
+            nearest_of_kind<TraitKind::INTERVAL, Dims>(set, pts, stride, i, ranked);
+            nearest_of_kind<TraitKind::POLYGON, Dims>(set, pts, stride, i, ranked);
+            nearest_of_kind<TraitKind::HYPERBOX, Dims>(set, pts, stride, i, ranked);
+            out.set(i, ranked);
+        }
+    }
+
+    static float trait_distance(TraitKind kind, const TraitParams& tr, const float* pts, size_t stride, size_t i) {
+        switch (kind) {
+            case TraitKind::POINT_1D: return trait_distance<TraitKind::POINT_1D, 0>(tr, pts, stride, i);
+            case TraitKind::POINT_2D: return trait_distance<TraitKind::POINT_2D, 0>(tr, pts, stride, i);
+            case TraitKind::ND_POINT: return trait_distance<TraitKind::ND_POINT, 0>(tr, pts, stride, i);
+            case TraitKind::INTERVAL: return trait_distance<TraitKind::INTERVAL, 0>(tr, pts, stride, i);
+            case TraitKind::POLYGON: return trait_distance<TraitKind::POLYGON, 0>(tr, pts, stride, i);
+            default: return trait_distance<TraitKind::HYPERBOX, 0>(tr, pts, stride, i);
+        }
+    }
+
+    // A bounding volume hierarchy over the traits in attribute space. Every trait is bounded by a box no
+    // farther from any voxel than the trait's own distance: the point itself, the interval or the box, and
+    // for polygons the rectangle (outside it the distance is to the centre, which is farther). Axes a trait
+    // doesn't constrain are unbounded. Boxes are stored flat, dims floats per node.
+    struct TraitIndex {
+        struct Entry {
+            TraitKind kind;
+            const TraitParams* params;
+        };
+
+        // Leaves hold entries [first, first + count), inner nodes have count 0 and two children
+        struct Node {
+            uint32_t first, count;
+            uint32_t left, right;
+        };
+
+        size_t dims;
+        std::vector<Entry> entries;
+        std::vector<uint32_t> entry_of; // Entry of each trait, by trait index
+        std::vector<Node> nodes;
+        std::vector<float> lo, hi;
+
+        TraitIndex(const TraitSet& set, size_t dims);
+
+        template <size_t Dims>
+        float box_distance(size_t node, const float* pt) const {
+            size_t axes = Dims ? Dims : dims;
+            const float* node_lo = lo.data() + node * axes;
+            const float* node_hi = hi.data() + node * axes;
+            float dsum = 0.0f;
+            // At most one side is positive, written without branches since which one is hard to predict
+            for (size_t a = 0; a < axes; a++) {
+                float d = std::max(node_lo[a] - pt[a], 0.0f) + std::max(pt[a] - node_hi[a], 0.0f);
+                dsum += d * d;
+            }
+            return dsum;
+        }
+
+    private:
+        uint32_t build(std::vector<float>& trait_lo, std::vector<float>& trait_hi, std::vector<uint32_t>& order,
+            size_t first, size_t count);
+    };
+
+    TraitIndex::TraitIndex(const TraitSet& set, size_t dims) : dims(dims) {
+        // Per trait boxes, in the order of entries
+        std::vector<float> trait_lo, trait_hi;
+        for (size_t k = 0; k < static_cast<size_t>(TraitKind::COUNT); k++) {
+            auto kind = static_cast<TraitKind>(k);
+            for (auto& tr : set.of(kind)) {
+                entries.push_back({kind, &tr});
+                size_t base = trait_lo.size();
+                trait_lo.resize(base + dims, -INFINITY);
+                trait_hi.resize(base + dims, INFINITY);
+                auto bound = [&] (size_t axis, float a, float b) {
+                    if (axis < dims) {
+                        trait_lo[base + axis] = std::min(a, b);
+                        trait_hi[base + axis] = std::max(a, b);
+                    }
+                };
+
+                switch (kind) {
+                    case TraitKind::POINT_1D:
+                        bound(0, tr.p[0], tr.p[0]);
+                        break;
+                    case TraitKind::POINT_2D:
+                        bound(0, tr.p[0], tr.p[0]);
+                        bound(1, tr.p[1], tr.p[1]);
+                        break;
+                    case TraitKind::INTERVAL:
+                        bound(0, tr.p[0], tr.p[1]);
+                        break;
+                    case TraitKind::POLYGON:
+                        bound(0, tr.p[0], tr.p[1]);
+                        bound(1, tr.p[2], tr.p[3]);
+                        break;
+                    case TraitKind::ND_POINT:
+                        for (size_t a = 0; a < tr.lo.size(); a++) {
+                            bound(a, tr.lo[a], tr.lo[a]);
+                        }
+                        break;
+                    default:
+                        for (size_t a = 0; a < tr.lo.size(); a++) {
+                            bound(a, tr.lo[a], tr.hi[a]);
+                        }
+                }
+            }
+        }
+
+        std::vector<uint32_t> order(entries.size());
+        for (size_t t = 0; t < order.size(); t++) {
+            order[t] = static_cast<uint32_t>(t);
+        }
+        build(trait_lo, trait_hi, order, 0, order.size());
+
+        std::vector<Entry> sorted;
+        for (auto t : order) {
+            sorted.push_back(entries[t]);
+        }
+        entries = std::move(sorted);
+
+        for (size_t e = 0; e < entries.size(); e++) {
+            auto trait = entries[e].params->index;
+            if (trait >= entry_of.size()) {
+                entry_of.resize(trait + 1);
+            }
+            entry_of[trait] = static_cast<uint32_t>(e);
+        }
+    }
+
+    // Splits at the median centre along the axis where trait centres spread the most. Unbounded sides
+    // don't count towards a centre.
+    uint32_t TraitIndex::build(std::vector<float>& trait_lo, std::vector<float>& trait_hi,
+        std::vector<uint32_t>& order, size_t first, size_t count) {
+        auto node = static_cast<uint32_t>(nodes.size());
+        nodes.push_back({static_cast<uint32_t>(first), static_cast<uint32_t>(count), 0, 0});
+        lo.resize(lo.size() + dims, INFINITY);
+        hi.resize(hi.size() + dims, -INFINITY);
+
+        auto centre = [&] (uint32_t t, size_t a) {
+            float l = trait_lo[t * dims + a], h = trait_hi[t * dims + a];
+            return std::isinf(l) ? (std::isinf(h) ? 0.0f : h) : (std::isinf(h) ? l : (l + h) / 2);
+        };
+
+        size_t split_axis = 0;
+        float split_extent = 0;
+        for (size_t a = 0; a < dims; a++) {
+            float c_min = INFINITY, c_max = -INFINITY;
+            for (size_t k = first; k < first + count; k++) {
+                auto t = order[k];
+                lo[node * dims + a] = std::min(lo[node * dims + a], trait_lo[t * dims + a]);
+                hi[node * dims + a] = std::max(hi[node * dims + a], trait_hi[t * dims + a]);
+                c_min = std::min(c_min, centre(t, a));
+                c_max = std::max(c_max, centre(t, a));
+            }
+            if (c_max - c_min > split_extent) {
+                split_extent = c_max - c_min;
+                split_axis = a;
+            }
+        }
+
+        // Traits that can't be told apart by their centres stay in one leaf
+        if (count <= DIST_INDEX_LEAF_TRAITS || split_extent == 0) {
+            return node;
+        }
+
+        size_t half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+            [&] (uint32_t a, uint32_t b) { return centre(a, split_axis) < centre(b, split_axis); });
+
+        auto left = build(trait_lo, trait_hi, order, first, half);
+        auto right = build(trait_lo, trait_hi, order, first + half, count - half);
+        nodes[node] = {0, 0, left, right};
+        return node;
+    }
+
+    // Best first descent, visiting the nearer child first. A subtree is skipped once its box is farther than
+    // the runner up, ties included, so the ranking is exactly what going over every trait would give.
+    // Neighbouring voxels tend to have similar attributes, so the search starts from the two traits that won
+    // the previous voxel, which lets most subtrees be skipped right away.
+    template <size_t Dims>
+    static void nearest_trait_indexed(const TraitSet& set, const float* pts, size_t stride, size_t count,
+        const RankedOutput& out) {
+        auto& index = *set.index;
+        thread_local std::vector<std::pair<float, uint32_t>> stack_storage;
+        thread_local std::vector<float> pt_storage;
+        auto& stack = stack_storage;
+        auto& pt = pt_storage;
+        pt.resize(index.dims);
+        auto pruned = [] (float bound, const RankedTraits& ranked) {
+            return bound * (1 - DIST_INDEX_SLACK) > ranked.second_dist;
+        };
+
+        // Traits that won the previous voxel
+        uint32_t seeds[2];
+        size_t num_seeds = 0;
+        for (size_t i = 0; i < count; i++) {
+            for (size_t a = 0; a < index.dims; a++) {
+                pt[a] = pts[a * stride + i];
+            }
+
+            RankedTraits ranked;
+            auto rank_entry = [&] (const TraitIndex::Entry& entry) {
+                rank_trait(ranked, trait_distance(entry.kind, *entry.params, pts, stride, i), entry.params->index);
+            };
+            for (size_t k = 0; k < num_seeds; k++) {
+                rank_entry(index.entries[index.entry_of[seeds[k]]]);
+            }
+
+            stack.clear();
+            stack.emplace_back(index.box_distance<Dims>(0, pt.data()), 0);
+            while (!stack.empty()) {
+                auto [bound, node] = stack.back();
+                stack.pop_back();
+                // The runner up may have moved closer since the node was pushed
+                if (pruned(bound, ranked)) {
+                    continue;
+                }
+
+                auto& n = index.nodes[node];
+                if (n.count) {
+                    for (size_t e = n.first; e < n.first + n.count; e++) {
+                        // Seeds are already ranked
+                        auto trait = index.entries[e].params->index;
+                        if (std::find(seeds, seeds + num_seeds, trait) == seeds + num_seeds) {
+                            rank_entry(index.entries[e]);
+                        }
+                    }
+                    continue;
+                }
+
+                float left = index.box_distance<Dims>(n.left, pt.data());
+                float right = index.box_distance<Dims>(n.right, pt.data());
+                auto near = std::make_pair(left, n.left), far = std::make_pair(right, n.right);
+                if (right < left) {
+                    std::swap(near, far);
+                }
+                if (!pruned(far.first, ranked)) {
+                    stack.push_back(far);
+                }
+                if (!pruned(near.first, ranked)) {
+                    stack.push_back(near);
+                }
+            }
+            out.set(i, ranked);
+
+            // Only real rankings, an unfilled second place still points at trait 0
+            num_seeds = 0;
+            if (ranked.dist < INFINITY) {
+                seeds[num_seeds++] = ranked.trait;
+            }
+            if (ranked.second_dist < INFINITY) {
+                seeds[num_seeds++] = ranked.second_trait;
+            }
+        }
+    }
+
+    static void index_traits(TraitSet& set, size_t dims) {
+        size_t min_traits = DIST_INDEX_MIN_TRAITS_SCALAR;
+        switch (distance_isa()) {
+            case DistanceIsa::AVX512: min_traits = DIST_INDEX_MIN_TRAITS_AVX512; break;
+            case DistanceIsa::AVX2: min_traits = DIST_INDEX_MIN_TRAITS_AVX2; break;
+            default: break;
+        }
+
+        if (set.size() >= min_traits) {
+            set.index = std::make_shared<TraitIndex>(set, dims);
+        }
+    }
+
+#ifdef MVF_X86_SIMD
+    template <TraitKind Kind, size_t Dims>
+    MVF_AVX2 static inline __m256 trait_distance_avx2(const TraitParams& tr, const float* block, size_t stride,
+        __m256 x, __m256 y) {
+        const __m256 zero = _mm256_setzero_ps();
+        if constexpr (Kind == TraitKind::POINT_1D) {
+            auto dx = _mm256_sub_ps(_mm256_set1_ps(tr.p[0]), x);
+            return _mm256_mul_ps(dx, dx);
+        }
+        else if constexpr (Kind == TraitKind::POINT_2D) {
+            auto dx = _mm256_sub_ps(_mm256_set1_ps(tr.p[0]), x);
+            auto dy = _mm256_sub_ps(_mm256_set1_ps(tr.p[1]), y);
+            return _mm256_add_ps(_mm256_mul_ps(dy, dy), _mm256_mul_ps(dx, dx));
+        }
+        else if constexpr (Kind == TraitKind::ND_POINT) {
+            auto dist = zero;
+            for (size_t a = 0; a < trait_axes<Dims>(tr); a++) {
+                auto d = _mm256_sub_ps(_mm256_set1_ps(tr.lo[a]), _mm256_loadu_ps(block + a * stride));
+                dist = _mm256_add_ps(dist, _mm256_mul_ps(d, d));
+            }
+            return dist;
+        }
+        else if constexpr (Kind == TraitKind::INTERVAL) {
+            const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+            auto left = _mm256_set1_ps(tr.p[0]), right = _mm256_set1_ps(tr.p[1]);
+            auto inside = _mm256_and_ps(_mm256_cmp_ps(x, left, _CMP_GE_OQ), _mm256_cmp_ps(x, right, _CMP_LE_OQ));
+            auto d = _mm256_min_ps(_mm256_and_ps(_mm256_sub_ps(right, x), abs_mask),
+                _mm256_and_ps(_mm256_sub_ps(left, x), abs_mask));
+            return _mm256_blendv_ps(_mm256_mul_ps(d, d), zero, inside);
+        }
+        else if constexpr (Kind == TraitKind::POLYGON) {
+            auto inside = _mm256_and_ps(
+                _mm256_and_ps(_mm256_cmp_ps(x, _mm256_set1_ps(tr.p[0]), _CMP_GE_OQ), _mm256_cmp_ps(x, _mm256_set1_ps(tr.p[1]), _CMP_LE_OQ)),
+                _mm256_and_ps(_mm256_cmp_ps(y, _mm256_set1_ps(tr.p[2]), _CMP_GE_OQ), _mm256_cmp_ps(y, _mm256_set1_ps(tr.p[3]), _CMP_LE_OQ)));
+            auto dx = _mm256_sub_ps(_mm256_set1_ps(tr.p[4]), x);
+            auto dy = _mm256_sub_ps(_mm256_set1_ps(tr.p[5]), y);
+            return _mm256_blendv_ps(_mm256_add_ps(_mm256_mul_ps(dy, dy), _mm256_mul_ps(dx, dx)), zero, inside);
+        }
+        else {
+            auto dist = zero;
+            for (size_t a = 0; a < trait_axes<Dims>(tr); a++) {
+                auto v = _mm256_loadu_ps(block + a * stride);
+                auto lo = _mm256_set1_ps(tr.lo[a]), hi = _mm256_set1_ps(tr.hi[a]);
+                auto d = _mm256_blendv_ps(zero, _mm256_sub_ps(v, hi), _mm256_cmp_ps(v, hi, _CMP_GT_OQ));
+                d = _mm256_blendv_ps(d, _mm256_sub_ps(lo, v), _mm256_cmp_ps(v, lo, _CMP_LT_OQ));
+                dist = _mm256_add_ps(dist, _mm256_mul_ps(d, d));
+            }
+            return dist;
+        }
+    }
+
+    struct RankedTraitsAvx2 {
+        __m256 dist, second_dist;
+        __m256i trait, second_trait;
+    };
+
+    MVF_AVX2 static inline __m256 ranks_before_avx2(__m256 dist, __m256i index, __m256 other_dist, __m256i other_index) {
+        return _mm256_or_ps(_mm256_cmp_ps(dist, other_dist, _CMP_LT_OQ), _mm256_and_ps(
+            _mm256_cmp_ps(dist, other_dist, _CMP_EQ_OQ), _mm256_castsi256_ps(_mm256_cmpgt_epi32(other_index, index))));
+    }
+
+    MVF_AVX2 static inline __m256i blend_epi32_avx2(__m256i a, __m256i b, __m256 mask) {
+        return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), mask));
+    }
+
+    template <TraitKind Kind, size_t Dims>
+    MVF_AVX2 static inline void nearest_of_kind_avx2(const TraitSet& set, const float* block, size_t stride,
+        __m256 x, __m256 y, RankedTraitsAvx2& r) {
+        for (auto& tr : set.of(Kind)) {
+            auto dist = trait_distance_avx2<Kind, Dims>(tr, block, stride, x, y);
+            auto index = _mm256_set1_epi32(static_cast<int>(tr.index));
+            // Lanes where the trait takes first place push the old winner down to second
+            auto first = ranks_before_avx2(dist, index, r.dist, r.trait);
+            auto second = ranks_before_avx2(dist, index, r.second_dist, r.second_trait);
+            r.second_dist = _mm256_blendv_ps(_mm256_blendv_ps(r.second_dist, dist, second), r.dist, first);
+            r.second_trait = blend_epi32_avx2(blend_epi32_avx2(r.second_trait, index, second), r.trait, first);
+            r.dist = _mm256_blendv_ps(r.dist, dist, first);
+            r.trait = blend_epi32_avx2(r.trait, index, first);
+        }
+    }
+
+    template <size_t Dims>
+    MVF_AVX2 static size_t nearest_trait_avx2(const TraitSet& set, const float* pts, size_t stride, size_t count,
+        const RankedOutput& out) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            // Every trait reads the first two components, the others are loaded as needed
+            const float* block = pts + i;
+            auto x = _mm256_loadu_ps(block);
+            auto y = _mm256_loadu_ps(block + stride);
+            RankedTraitsAvx2 ranked = {_mm256_set1_ps(INFINITY), _mm256_set1_ps(INFINITY), _mm256_setzero_si256(),
+                _mm256_setzero_si256()};
+            nearest_of_kind_avx2<TraitKind::POINT_1D, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx2<TraitKind::POINT_2D, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx2<TraitKind::ND_POINT, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx2<TraitKind::INTERVAL, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx2<TraitKind::POLYGON, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx2<TraitKind::HYPERBOX, Dims>(set, block, stride, x, y, ranked);
+            _mm256_storeu_ps(out.dist + i, ranked.dist);
+            _mm256_storeu_ps(out.second_dist + i, ranked.second_dist);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.trait + i), ranked.trait);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.second_trait + i), ranked.second_trait);
+        }
+        return i;
+    }
+
+    template <TraitKind Kind, size_t Dims>
+    MVF_AVX512 static inline __m512 trait_distance_avx512(const TraitParams& tr, const float* block, size_t stride,
+        __m512 x, __m512 y) {
+        const __m512 zero = _mm512_setzero_ps();
+        if constexpr (Kind == TraitKind::POINT_1D) {
+            auto dx = _mm512_sub_ps(_mm512_set1_ps(tr.p[0]), x);
+            return _mm512_mul_ps(dx, dx);
+        }
+        else if constexpr (Kind == TraitKind::POINT_2D) {
+            auto dx = _mm512_sub_ps(_mm512_set1_ps(tr.p[0]), x);
+            auto dy = _mm512_sub_ps(_mm512_set1_ps(tr.p[1]), y);
+            return _mm512_add_ps(_mm512_mul_ps(dy, dy), _mm512_mul_ps(dx, dx));
+        }
+        else if constexpr (Kind == TraitKind::ND_POINT) {
+            auto dist = zero;
+            for (size_t a = 0; a < trait_axes<Dims>(tr); a++) {
+                auto d = _mm512_sub_ps(_mm512_set1_ps(tr.lo[a]), _mm512_loadu_ps(block + a * stride));
+                dist = _mm512_add_ps(dist, _mm512_mul_ps(d, d));
+            }
+            return dist;
+        }
+        else if constexpr (Kind == TraitKind::INTERVAL) {
+            auto left = _mm512_set1_ps(tr.p[0]), right = _mm512_set1_ps(tr.p[1]);
+            auto inside = _mm512_cmp_ps_mask(x, left, _CMP_GE_OQ) & _mm512_cmp_ps_mask(x, right, _CMP_LE_OQ);
+            // Same as _mm512_min_ps, which trips a false uninitialized warning in some GCC headers
+            auto dr = _mm512_abs_ps(_mm512_sub_ps(right, x)), dl = _mm512_abs_ps(_mm512_sub_ps(left, x));
+            auto d = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(dr, dl, _CMP_LT_OQ), dl, dr);
+            return _mm512_mask_blend_ps(inside, _mm512_mul_ps(d, d), zero);
+        }
+        else if constexpr (Kind == TraitKind::POLYGON) {
+            auto inside = _mm512_cmp_ps_mask(x, _mm512_set1_ps(tr.p[0]), _CMP_GE_OQ)
+                & _mm512_cmp_ps_mask(x, _mm512_set1_ps(tr.p[1]), _CMP_LE_OQ)
+                & _mm512_cmp_ps_mask(y, _mm512_set1_ps(tr.p[2]), _CMP_GE_OQ)
+                & _mm512_cmp_ps_mask(y, _mm512_set1_ps(tr.p[3]), _CMP_LE_OQ);
+            auto dx = _mm512_sub_ps(_mm512_set1_ps(tr.p[4]), x);
+            auto dy = _mm512_sub_ps(_mm512_set1_ps(tr.p[5]), y);
+            return _mm512_mask_blend_ps(inside, _mm512_add_ps(_mm512_mul_ps(dy, dy), _mm512_mul_ps(dx, dx)), zero);
+        }
+        else {
+            auto dist = zero;
+            for (size_t a = 0; a < trait_axes<Dims>(tr); a++) {
+                auto v = _mm512_loadu_ps(block + a * stride);
+                auto lo = _mm512_set1_ps(tr.lo[a]), hi = _mm512_set1_ps(tr.hi[a]);
+                auto d = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(v, hi, _CMP_GT_OQ), zero, _mm512_sub_ps(v, hi));
+                d = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(v, lo, _CMP_LT_OQ), d, _mm512_sub_ps(lo, v));
+                dist = _mm512_add_ps(dist, _mm512_mul_ps(d, d));
+            }
+            return dist;
+        }
+    }
+
+    struct RankedTraitsAvx512 {
+        __m512 dist, second_dist;
+        __m512i trait, second_trait;
+    };
+
+    MVF_AVX512 static inline __mmask16 ranks_before_avx512(__m512 dist, __m512i index, __m512 other_dist,
+        __m512i other_index) {
+        return _mm512_cmp_ps_mask(dist, other_dist, _CMP_LT_OQ)
+            | (_mm512_cmp_ps_mask(dist, other_dist, _CMP_EQ_OQ) & _mm512_cmpgt_epi32_mask(other_index, index));
+    }
+
+    template <TraitKind Kind, size_t Dims>
+    MVF_AVX512 static inline void nearest_of_kind_avx512(const TraitSet& set, const float* block, size_t stride,
+        __m512 x, __m512 y, RankedTraitsAvx512& r) {
+        for (auto& tr : set.of(Kind)) {
+            auto dist = trait_distance_avx512<Kind, Dims>(tr, block, stride, x, y);
+            auto index = _mm512_set1_epi32(static_cast<int>(tr.index));
+            // Lanes where the trait takes first place push the old winner down to second
+            auto first = ranks_before_avx512(dist, index, r.dist, r.trait);
+            auto second = ranks_before_avx512(dist, index, r.second_dist, r.second_trait);
+            r.second_dist = _mm512_mask_blend_ps(first, _mm512_mask_blend_ps(second, r.second_dist, dist), r.dist);
+            r.second_trait = _mm512_mask_blend_epi32(first, _mm512_mask_blend_epi32(second, r.second_trait, index), r.trait);
+            r.dist = _mm512_mask_blend_ps(first, r.dist, dist);
+            r.trait = _mm512_mask_blend_epi32(first, r.trait, index);
+        }
+    }
+
+    template <size_t Dims>
+    MVF_AVX512 static size_t nearest_trait_avx512(const TraitSet& set, const float* pts, size_t stride, size_t count,
+        const RankedOutput& out) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            // Every trait reads the first two components, the others are loaded as needed
+            const float* block = pts + i;
+            auto x = _mm512_loadu_ps(block);
+            auto y = _mm512_loadu_ps(block + stride);
+            RankedTraitsAvx512 ranked = {_mm512_set1_ps(INFINITY), _mm512_set1_ps(INFINITY), _mm512_setzero_si512(),
+                _mm512_setzero_si512()};
+            nearest_of_kind_avx512<TraitKind::POINT_1D, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx512<TraitKind::POINT_2D, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx512<TraitKind::ND_POINT, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx512<TraitKind::INTERVAL, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx512<TraitKind::POLYGON, Dims>(set, block, stride, x, y, ranked);
+            nearest_of_kind_avx512<TraitKind::HYPERBOX, Dims>(set, block, stride, x, y, ranked);
+            _mm512_storeu_ps(out.dist + i, ranked.dist);
+            _mm512_storeu_ps(out.second_dist + i, ranked.second_dist);
+            _mm512_storeu_si512(out.trait + i, ranked.trait);
+            _mm512_storeu_si512(out.second_trait + i, ranked.second_trait);
+        }
+        return i;
+    }
+#endif
+
+    using VectorKernel = size_t (*)(const TraitSet& set, const float* pts, size_t stride, size_t count,
+        const RankedOutput& out);
+    using NearestTrait = void (*)(const TraitSet& set, const float* pts, size_t stride, size_t count,
+        const RankedOutput& out);
+
+    template <size_t Dims, VectorKernel Vector>
+    static void nearest_trait(const TraitSet& set, const float* pts, size_t stride, size_t count,
+        const RankedOutput& out) {
+        size_t i = 0;
+        if constexpr (Vector != nullptr) {
+            i = Vector(set, pts, stride, count, out);
+        }
+        nearest_trait_scalar<Dims>(set, pts, stride, i, count, out);
+    }
+
+    template <size_t Dims>
+    static NearestTrait select_isa() {
+#ifdef MVF_X86_SIMD
+        switch (distance_isa()) {
+            case DistanceIsa::AVX512: return nearest_trait<Dims, nearest_trait_avx512<Dims>>;
+            case DistanceIsa::AVX2: return nearest_trait<Dims, nearest_trait_avx2<Dims>>;
+            default: break;
+        }
+#endif
+        return nearest_trait<Dims, nullptr>;
+    }
+
+    // Picks the kernel for this attribute count and CPU once, before any voxel is visited. Up to 4 attributes
+    // have kernels of their own, as long as every n-d trait spans all of them. Everything else goes through
+    // the generic (0) instantiation. Indexed sets are searched through their hierarchy instead.
+    static NearestTrait select_nearest_trait(const TraitSet& set, size_t dims) {
+        if (set.index) {
+            switch (dims) {
+                case 1: return nearest_trait_indexed<1>;
+                case 2: return nearest_trait_indexed<2>;
+                case 3: return nearest_trait_indexed<3>;
+                case 4: return nearest_trait_indexed<4>;
+                default: return nearest_trait_indexed<0>;
+            }
+        }
+
+        bool full_axes = true;
+        for (auto kind : {TraitKind::ND_POINT, TraitKind::HYPERBOX}) {
+            for (auto& tr : set.of(kind)) {
+                full_axes = full_axes && tr.lo.size() == dims;
+            }
+        }
+
+        if (full_axes) {
+            switch (dims) {
+                case 1: return select_isa<1>();
+                case 2: return select_isa<2>();
+                case 3: return select_isa<3>();
+                case 4: return select_isa<4>();
+            }
+        }
+        return select_isa<0>();
+    }
+
+    // Marks old traits that are no longer in the list
+    constexpr uint32_t REMOVED_TRAIT = UINT32_MAX;
+
+    // Works out whether the last build in state can be brought up to date rather than starting over. It can
+    // when it was for the same volume and attributes and at least one trait is still there, with kept traits
+    // in the same relative order so that ties still go the same way. remap then takes an old trait index to
+    // the new one (or REMOVED_TRAIT) and added holds the traits that are new or were edited.
+    static bool plan_update(const DistanceState& state, const std::shared_ptr<VolumeData>& data,
+        const std::vector<std::string>& comps, size_t grid_size, const std::vector<ResolvedTrait>& resolved,
+        std::vector<uint32_t>& remap, TraitSet& added) {
+        if (state.source.lock() != data || state.comps != comps || state.dist.size() != grid_size) {
+            return false;
+        }
+
+        std::vector<ResolvedTrait> old_resolved;
+        for (size_t t = 0; t < state.traits.size(); t++) {
+            old_resolved.push_back(resolve_trait(state.traits[t], static_cast<uint32_t>(t), comps.size()));
+        }
+
+        remap.assign(old_resolved.size(), REMOVED_TRAIT);
+        for (auto& trait : resolved) {
+            bool kept = false;
+            for (size_t t = 0; t < old_resolved.size() && !kept; t++) {
+                if (remap[t] == REMOVED_TRAIT && old_resolved[t] == trait) {
+                    remap[t] = trait.params.index;
+                    kept = true;
+                }
+            }
+            if (!kept) {
+                added.add(trait);
+            }
+        }
+
+        bool any_kept = false;
+        uint32_t last_index = 0;
+        for (auto index : remap) {
+            if (index == REMOVED_TRAIT) {
+                continue;
+            }
+            if (any_kept && index < last_index) {
+                return false;
+            }
+            any_kept = true;
+            last_index = index;
+        }
+
+        return any_kept;
+    }
+
+    // Squared distance and winning trait at the nodes of a regular grid over the attribute ranges. Node k of
+    // axis a sits at lo[a] + k * step[a], the first axis varies fastest.
+    struct LookupTable {
+        size_t dims, nodes;
+        float lo[3], step[3];
+        std::vector<float> dist;
+        std::vector<uint32_t> trait;
+    };
+
+    static size_t lookup_table_size(size_t dims) {
+        size_t total = 1;
+        for (size_t a = 0; a < dims; a++) {
+            total *= DIST_LUT_NODES[dims];
+        }
+        return total;
+    }
+
+    // The nodes are ranked by the same kernels as voxels, a block of them at a time
+    static LookupTable build_lookup_table(const std::vector<AxisDescMeta>& attrib_comps, const TraitSet& set,
+        NearestTrait nearest_trait) {
+        LookupTable table;
+        table.dims = attrib_comps.size();
+        table.nodes = DIST_LUT_NODES[table.dims];
+        for (size_t a = 0; a < table.dims; a++) {
+            table.lo[a] = attrib_comps[a].min_val;
+            table.step[a] = (attrib_comps[a].max_val - attrib_comps[a].min_val) / (table.nodes - 1);
+        }
+
+        size_t total = lookup_table_size(table.dims);
+        table.dist.resize(total);
+        table.trait.resize(total);
+        parallel_for((total + DIST_BLOCK_VOXELS - 1) / DIST_BLOCK_VOXELS, [&] (size_t block) {
+            thread_local std::vector<float> pts, second_dist;
+            thread_local std::vector<uint32_t> second_trait;
+            pts.assign(std::max<size_t>(table.dims, 2) * DIST_BLOCK_VOXELS, 0.0f);
+            second_dist.resize(DIST_BLOCK_VOXELS);
+            second_trait.resize(DIST_BLOCK_VOXELS);
+
+            size_t first = block * DIST_BLOCK_VOXELS;
+            size_t count = std::min(DIST_BLOCK_VOXELS, total - first);
+            for (size_t j = 0; j < count; j++) {
+                size_t node = first + j;
+                for (size_t a = 0; a < table.dims; a++) {
+                    pts[a * DIST_BLOCK_VOXELS + j] = table.lo[a] + (node % table.nodes) * table.step[a];
+                    node /= table.nodes;
+                }
+            }
+            nearest_trait(set, pts.data(), DIST_BLOCK_VOXELS, count,
+                {table.dist.data() + first, second_dist.data(), table.trait.data() + first, second_trait.data()});
+        });
+
+        return table;
+    }
+
+    // Interpolates the distance between the nodes around each voxel, the winner is the nearest node's. Values
+    // outside the attribute ranges are clamped to them.
+    template <size_t Dims>
+    static void lookup_distances(const LookupTable& table, const float* pts, size_t stride, size_t count,
+        float* dist, uint32_t* trait) {
+        float last = static_cast<float>(table.nodes - 1);
+        for (size_t i = 0; i < count; i++) {
+            size_t base = 0, nearest = 0, node_stride = 1;
+            size_t strides[Dims];
+            float frac[Dims];
+            for (size_t a = 0; a < Dims; a++) {
+                float t = table.step[a] > 0 ? (pts[a * stride + i] - table.lo[a]) / table.step[a] : 0;
+                t = t >= 0 ? std::min(t, last) : 0; // Also catches NaN
+                size_t k = std::min(static_cast<size_t>(t), table.nodes - 2);
+                frac[a] = t - k;
+                base += k * node_stride;
+                nearest += static_cast<size_t>(t + 0.5f) * node_stride;
+                strides[a] = node_stride;
+                node_stride *= table.nodes;
+            }
+
+            float d = 0;
+            for (size_t corner = 0; corner < (size_t(1) << Dims); corner++) {
+                float w = 1;
+                size_t node = base;
+                for (size_t a = 0; a < Dims; a++) {
+                    if (corner & (size_t(1) << a)) {
+                        w *= frac[a];
+                        node += strides[a];
+                    }
+                    else {
+                        w *= 1 - frac[a];
+                    }
+                }
+                d += w * table.dist[node];
+            }
+            dist[i] = d;
+            trait[i] = table.trait[nearest];
+        }
+    }
+
+    static void lookup_distances(const LookupTable& table, const float* pts, size_t stride, size_t count,
+        float* dist, uint32_t* trait) {
+        switch (table.dims) {
+            case 1: lookup_distances<1>(table, pts, stride, count, dist, trait); break;
+            case 2: lookup_distances<2>(table, pts, stride, count, dist, trait); break;
+            default: lookup_distances<3>(table, pts, stride, count, dist, trait); break;
+        }
+    }
+
+    // Compares a table build with exact distances at voxels spread evenly over the volume
+    static void measure_lookup_error(const std::vector<const ScalarField*>& columns, const std::vector<Trait>& traits,
+        const TraitSet& set, NearestTrait nearest_trait, const DistanceState& state, float max_dist,
+        DistanceReport& report) {
+        size_t grid_size = state.dist.size();
+        size_t samples = std::min(grid_size, DIST_LUT_SAMPLES);
+        size_t num_blocks = (samples + DIST_BLOCK_VOXELS - 1) / DIST_BLOCK_VOXELS;
+        std::vector<float> block_max(num_blocks, 0), block_sum(num_blocks, 0);
+        std::vector<size_t> block_mismatch(num_blocks, 0);
+
+        parallel_for(num_blocks, [&] (size_t block) {
+            thread_local std::vector<float> pts, dists[2];
+            thread_local std::vector<uint32_t> winners[2];
+            pts.assign(std::max<size_t>(columns.size(), 2) * DIST_BLOCK_VOXELS, 0.0f);
+            for (size_t k = 0; k < 2; k++) {
+                dists[k].resize(DIST_BLOCK_VOXELS);
+                winners[k].resize(DIST_BLOCK_VOXELS);
+            }
+
+            size_t first = block * DIST_BLOCK_VOXELS;
+            size_t count = std::min(DIST_BLOCK_VOXELS, samples - first);
+            auto voxel = [&] (size_t j) { return (first + j) * grid_size / samples; };
+            for (size_t a = 0; a < columns.size(); a++) {
+                for (size_t j = 0; j < count; j++) {
+                    pts[a * DIST_BLOCK_VOXELS + j] = (*columns[a])[voxel(j)];
+                }
+            }
+            nearest_trait(set, pts.data(), DIST_BLOCK_VOXELS, count,
+                {dists[0].data(), dists[1].data(), winners[0].data(), winners[1].data()});
+
+            for (size_t j = 0; j < count; j++) {
+                auto v = voxel(j);
+                float error = max_dist > 0 ? std::abs(state.dist[v] - dists[0][j]) / max_dist : 0;
+                block_max[block] = std::max(error, block_max[block]);
+                block_sum[block] += error;
+                if (traits[state.trait[v]].color_id != traits[winners[0][j]].color_id) {
+                    block_mismatch[block]++;
+                }
+            }
+        });
+
+        report.samples = samples;
+        float sum = 0;
+        size_t mismatch = 0;
+        for (size_t block = 0; block < num_blocks; block++) {
+            report.max_error = std::max(block_max[block], report.max_error);
+            sum += block_sum[block];
+            mismatch += block_mismatch[block];
+        }
+        report.mean_error = samples ? sum / samples : 0;
+        report.color_mismatch = samples ? static_cast<float>(mismatch) / samples : 0;
+    }
+
+    // Fills pts with the attribute tuples of voxels that are not next to each other
+    static void gather_voxels(const std::vector<const ScalarField*>& columns, const size_t* voxels, size_t count,
+        float* pts, size_t stride) {
+        for (size_t a = 0; a < columns.size(); a++) {
+            for (size_t j = 0; j < count; j++) {
+                pts[a * stride + j] = (*columns[a])[voxels[j]];
+            }
+        }
+    }
+
+    // Voxels along an axis of n voxels that are a multiple of stride
+    static size_t strided_size(size_t n, size_t stride) {
+        return (n + stride - 1) / stride;
+    }
+
+    // The finest power of two stride at which at most DIST_PREVIEW_VOXELS voxels are left. A stride of 1 means
+    // the volume is small enough to go without previews.
+    static size_t first_preview_stride(const VolumeData& data) {
+        size_t stride = 1;
+        while (strided_size(data.nx, stride) * strided_size(data.ny, stride) * strided_size(data.nz, stride) >
+            DIST_PREVIEW_VOXELS) {
+            stride *= 2;
+        }
+        return stride;
+    }
+
+    // Ranks the voxels whose coordinates are all multiples of stride, except for those that are multiples of twice
+    // the stride, which a coarser level already has. The coarsest level ranks all of them.
+    static void rank_level(const VolumeData& data, const std::vector<const ScalarField*>& columns, const TraitSet& set,
+        NearestTrait nearest_trait, size_t stride, bool coarsest, RankedOutput ranks, const std::atomic<bool>& stop,
+        const std::function<void(size_t count)>& done) {
+        size_t nx = data.nx, ny = data.ny;
+        parallel_for(strided_size(data.nz, stride), [&] (size_t plane) {
+            if (stop.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            thread_local std::vector<size_t> voxels;
+            thread_local std::vector<float> pts, dists[2];
+            thread_local std::vector<uint32_t> winners[2];
+            pts.assign(std::max<size_t>(columns.size(), 2) * DIST_BLOCK_VOXELS, 0.0f);
+            for (size_t k = 0; k < 2; k++) {
+                dists[k].resize(DIST_BLOCK_VOXELS);
+                winners[k].resize(DIST_BLOCK_VOXELS);
+            }
+            RankedOutput scratch = {dists[0].data(), dists[1].data(), winners[0].data(), winners[1].data()};
+            voxels.clear();
+
+            size_t ranked = 0;
+            auto flush = [&] {
+                gather_voxels(columns, voxels.data(), voxels.size(), pts.data(), DIST_BLOCK_VOXELS);
+                nearest_trait(set, pts.data(), DIST_BLOCK_VOXELS, voxels.size(), scratch);
+                for (size_t k = 0; k < voxels.size(); k++) {
+                    ranks.set(voxels[k], scratch.get(k));
+                }
+                ranked += voxels.size();
+                voxels.clear();
+            };
+
+            size_t z = plane * stride;
+            for (size_t y = 0; y < ny; y += stride) {
+                for (size_t x = 0; x < nx; x += stride) {
+                    if (!coarsest && ((x | y | z) & stride) == 0) {
+                        continue;
+                    }
+                    voxels.push_back((z * ny + y) * nx + x);
+                    if (voxels.size() == DIST_BLOCK_VOXELS) {
+                        flush();
+                    }
+                }
+            }
+            if (!voxels.empty()) {
+                flush();
+            }
+            done(ranked);
+        });
+    }
+
+    static DistancePreview make_preview(const VolumeData& data, const DistanceState& state,
+        const std::vector<Trait>& traits, size_t stride) {
+        DistancePreview preview;
+        preview.stride = stride;
+        preview.nx = strided_size(data.nx, stride);
+        preview.ny = strided_size(data.ny, stride);
+        preview.nz = strided_size(data.nz, stride);
+        preview.field.resize(preview.nx * preview.ny * preview.nz);
+        preview.color_ids.resize(preview.field.size());
+
+        auto voxel = [&] (size_t i, size_t j, size_t k) {
+            return ((k * data.ny + j) * data.nx + i) * stride;
+        };
+
+        std::vector<float> plane_max(preview.nz, 0);
+        parallel_for(preview.nz, [&] (size_t k) {
+            for (size_t j = 0; j < preview.ny; j++) {
+                for (size_t i = 0; i < preview.nx; i++) {
+                    plane_max[k] = std::max(state.dist[voxel(i, j, k)], plane_max[k]);
+                }
+            }
+        });
+
+        float max_dist = 0;
+        for (auto plane_dist : plane_max) {
+            max_dist = std::max(plane_dist, max_dist);
+        }
+        float scale = max_dist > 0 ? DISTANCE_FIELD_ONE / max_dist : 0;
+
+        parallel_for(preview.nz, [&] (size_t k) {
+            for (size_t j = 0; j < preview.ny; j++) {
+                for (size_t i = 0; i < preview.nx; i++) {
+                    auto v = voxel(i, j, k);
+                    auto p = (k * preview.ny + j) * preview.nx + i;
+                    preview.field[p] = static_cast<uint16_t>(state.dist[v] * scale + 0.5f);
+                    preview.color_ids[p] = static_cast<uint8_t>(traits[state.trait[v]].color_id);
+                }
+            }
+        });
+
+        return preview;
+    }
+
+    // Integer attributes up to 16 bits are packed side by side into a key per voxel, which only works while
+    // they fit in 64 bits
+    static bool has_tuple_keys(const std::vector<const ScalarField*>& columns) {
+        size_t bits = 0;
+        for (auto column : columns) {
+            if (column->type() == FieldType::FLOAT32) {
+                return false;
+            }
+            bits += 8 * column->element_size();
+        }
+        return bits <= 64;
+    }
+
+    static void tuple_keys(const std::vector<const ScalarField*>& columns, size_t first, size_t count,
+        uint64_t* keys) {
+        std::fill(keys, keys + count, 0);
+        for (auto column : columns) {
+            column->visit([&] (const auto* values) {
+                using T = std::remove_cv_t<std::remove_pointer_t<decltype(values)>>;
+                if constexpr (std::is_integral_v<T>) {
+                    for (size_t j = 0; j < count; j++) {
+                        keys[j] = (keys[j] << (8 * sizeof(T))) | static_cast<std::make_unsigned_t<T>>(values[first + j]);
+                    }
+                }
+            });
+        }
+    }
+
+    // Open addressing from tuple keys to their position in a list of unique tuples
+    class TupleTable {
+    public:
+        static constexpr uint32_t EMPTY = UINT32_MAX;
+
+        // Makes room for at least capacity tuples, with the table at most half full
+        void reset(size_t capacity) {
+            size_t slots = 2;
+            shift = 63;
+            while (slots < 2 * capacity) {
+                slots *= 2;
+                shift--;
+            }
+            keys.assign(slots, 0);
+            tuples.assign(slots, EMPTY);
+        }
+
+        uint32_t find(uint64_t key) const {
+            for (size_t s = slot(key);; s = (s + 1) & (keys.size() - 1)) {
+                if (tuples[s] == EMPTY || keys[s] == key) {
+                    return tuples[s];
+                }
+            }
+        }
+
+        // Returns the tuple stored under key, storing tuple there first if there is none
+        uint32_t insert(uint64_t key, uint32_t tuple) {
+            size_t s = slot(key);
+            while (tuples[s] != EMPTY && keys[s] != key) {
+                s = (s + 1) & (keys.size() - 1);
+            }
+            if (tuples[s] == EMPTY) {
+                keys[s] = key;
+                tuples[s] = tuple;
+            }
+            return tuples[s];
+        }
+
+        // Empties the table again, given every key that was inserted
+        void clear(const std::vector<uint64_t>& inserted) {
+            for (auto key : inserted) {
+                size_t s = slot(key);
+                while (keys[s] != key) {
+                    s = (s + 1) & (keys.size() - 1);
+                }
+                tuples[s] = EMPTY;
+            }
+        }
+
+    private:
+        std::vector<uint64_t> keys;
+        std::vector<uint32_t> tuples;
+        int shift = 63;
+
+        size_t slot(uint64_t key) const {
+            return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift);
+        }
+    };
+
+    // The distinct attribute tuples of a volume along with their ranked traits, which voxels copy instead
+    // of ranking the same tuple over and over
+    struct UniqueTuples {
+        TupleTable table;
+        std::vector<size_t> voxels; // A voxel holding each tuple
+        std::vector<float> dist, second_dist;
+        std::vector<uint32_t> trait, second_trait;
+
+        RankedOutput ranks() {
+            return {dist.data(), second_dist.data(), trait.data(), second_trait.data()};
+        }
+    };
+
+    // Counts the distinct tuples among voxels spread evenly over the volume. Few distinct ones in there means
+    // voxels repeat each other a lot, as in label maps and low bit depth scans.
+    static bool repeats_tuples(const std::vector<const ScalarField*>& columns, size_t grid_size) {
+        size_t samples = std::min(grid_size, DIST_UNIQUE_SAMPLES);
+        TupleTable table;
+        table.reset(samples);
+        uint32_t distinct = 0;
+        for (size_t k = 0; k < samples; k++) {
+            uint64_t key;
+            tuple_keys(columns, k * grid_size / samples, 1, &key);
+            if (table.insert(key, distinct) == distinct) {
+                distinct++;
+            }
+        }
+        return distinct * DIST_UNIQUE_MIN_REUSE <= samples;
+    }
+
+    // Every slab first gathers its own distinct tuples, so that the shared table is only locked once per slab
+    // and tuple rather than per voxel. Gives up once there are too many tuples for this to pay off.
+    static std::optional<UniqueTuples> find_unique_tuples(const std::vector<const ScalarField*>& columns,
+        size_t grid_size, size_t slab_size, size_t num_slabs, const std::atomic<bool>& stop) {
+        if (!has_tuple_keys(columns) || grid_size < DIST_UNIQUE_SAMPLES || !repeats_tuples(columns, grid_size)) {
+            return std::nullopt;
+        }
+
+        size_t max_tuples = std::min(grid_size / DIST_UNIQUE_MIN_REUSE, DIST_UNIQUE_MAX_TUPLES);
+        UniqueTuples unique;
+        unique.table.reset(max_tuples);
+        std::mutex unique_lock;
+        std::atomic<bool> too_many = false;
+
+        parallel_for(num_slabs, [&] (size_t slab) {
+            if (stop.load(std::memory_order_relaxed) || too_many.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            size_t first = slab * slab_size;
+            size_t last = std::min(first + slab_size, grid_size);
+            thread_local TupleTable slab_table;
+            thread_local size_t slab_capacity = 0;
+            thread_local std::vector<uint64_t> keys, slab_keys;
+            thread_local std::vector<size_t> slab_voxels;
+            if (slab_capacity < last - first) {
+                slab_capacity = last - first;
+                slab_table.reset(slab_capacity);
+            }
+            keys.resize(DIST_BLOCK_VOXELS);
+            slab_keys.clear();
+            slab_voxels.clear();
+
+            for (size_t block = first; block < last; block += DIST_BLOCK_VOXELS) {
+                size_t count = std::min(DIST_BLOCK_VOXELS, last - block);
+                tuple_keys(columns, block, count, keys.data());
+                for (size_t j = 0; j < count; j++) {
+                    // Neighbouring voxels often hold the same tuple
+                    if (j > 0 && keys[j] == keys[j - 1]) {
+                        continue;
+                    }
+                    auto tuple = static_cast<uint32_t>(slab_keys.size());
+                    if (slab_table.insert(keys[j], tuple) == tuple) {
+                        slab_keys.push_back(keys[j]);
+                        slab_voxels.push_back(block + j);
+                    }
+                }
+            }
+            slab_table.clear(slab_keys);
+
+            std::lock_guard<std::mutex> lock(unique_lock);
+            for (size_t k = 0; k < slab_keys.size() && !too_many.load(std::memory_order_relaxed); k++) {
+                auto tuple = static_cast<uint32_t>(unique.voxels.size());
+                if (unique.table.insert(slab_keys[k], tuple) != tuple) {
+                    continue;
+                }
+                unique.voxels.push_back(slab_voxels[k]);
+                if (unique.voxels.size() >= max_tuples) {
+                    too_many.store(true, std::memory_order_relaxed);
+                }
+            }
+        });
+
+        if (too_many.load(std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return unique;
+    }
+
+    static void rank_unique_tuples(UniqueTuples& unique, const std::vector<const ScalarField*>& columns,
+        const TraitSet& set, NearestTrait nearest_trait, const std::atomic<bool>& stop) {
+        size_t total = unique.voxels.size();
+        unique.dist.resize(total);
+        unique.second_dist.resize(total);
+        unique.trait.resize(total);
+        unique.second_trait.resize(total);
+        auto ranks = unique.ranks();
+
+        parallel_for((total + DIST_BLOCK_VOXELS - 1) / DIST_BLOCK_VOXELS, [&] (size_t block) {
+            if (stop.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            thread_local std::vector<float> pts;
+            pts.assign(std::max<size_t>(columns.size(), 2) * DIST_BLOCK_VOXELS, 0.0f);
+            size_t first = block * DIST_BLOCK_VOXELS;
+            size_t count = std::min(DIST_BLOCK_VOXELS, total - first);
+            gather_voxels(columns, unique.voxels.data() + first, count, pts.data(), DIST_BLOCK_VOXELS);
+            nearest_trait(set, pts.data(), DIST_BLOCK_VOXELS, count, ranks + first);
+        });
+    }
+
+    std::string DistanceReport::summary() const {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        switch (mode) {
+            case DistanceMode::FULL:
+                ss << "computed in " << seconds << " s";
+                if (unique_tuples) {
+                    ss << " over " << unique_tuples << " distinct attribute tuples";
+                }
+                break;
+            case DistanceMode::INCREMENTAL:
+                ss << "updated in " << seconds << " s";
+                break;
+            case DistanceMode::LOOKUP_TABLE:
+                ss << "computed in " << seconds << " s from a lookup table of " << table_size << " nodes per axis | "
+                   << std::defaultfloat << "error max " << max_error << ", mean " << mean_error << " over "
+                   << samples << " voxels, " << std::fixed << color_mismatch * 100 << "% coloured differently";
+                break;
+        }
+        return ss.str();
+    }
+
+    bool compute_distance_field(const std::shared_ptr<VolumeData>& data, const std::vector<AxisDescMeta>& attrib_comps,
+        const std::vector<Trait>& traits, std::vector<uint16_t>& field, std::vector<uint8_t>& color_ids,
+        DistanceState& state, const DistanceOptions& options, DistanceReport& report, const std::atomic<bool>& stop,
+        const DistanceProgress& progress) {
+        if (traits.empty()) {
+            throw std::runtime_error("compute_distance_field() called with no traits");
+        }
+
+        auto start_time = std::chrono::steady_clock::now();
+        report = {};
+
+        size_t row_size = static_cast<size_t>(data->nx);
+        size_t grid_size = row_size * data->ny * data->nz;
+        field.resize(grid_size);
+        color_ids.resize(grid_size);
+
+        // Look the attribute columns up once rather than per voxel
+        std::vector<const ScalarField*> columns;
+        std::vector<std::string> comps;
+        for (auto& comp : attrib_comps) {
+            auto it = data->scalars.find(comp.desc.comp_name);
+            if (it == data->scalars.end() || it->second.size() < grid_size) {
+                throw std::runtime_error("Attribute component " + comp.desc.comp_name + " is not loaded");
+            }
+            columns.push_back(&it->second);
+            comps.push_back(comp.desc.comp_name);
+        }
+
+        size_t dims = columns.size();
+        TraitSet trait_set;
+        std::vector<ResolvedTrait> resolved;
+        for (size_t t = 0; t < traits.size(); t++) {
+            resolved.push_back(resolve_trait(traits[t], static_cast<uint32_t>(t), dims));
+            trait_set.add(resolved.back());
+        }
+        index_traits(trait_set, dims);
+        auto nearest_trait = select_nearest_trait(trait_set, dims);
+
+        // A table only pays off when it has fewer nodes than the volume has voxels
+        std::optional<LookupTable> table;
+        if (options.lookup_table && dims >= 1 && dims <= 3 && lookup_table_size(dims) < grid_size) {
+            table = build_lookup_table(attrib_comps, trait_set, nearest_trait);
+            report.mode = DistanceMode::LOOKUP_TABLE;
+            report.table_size = table->nodes;
+        }
+
+        std::vector<uint32_t> remap;
+        TraitSet added;
+        bool incremental = options.incremental && !table && plan_update(state, data, comps, grid_size, resolved,
+            remap, added);
+        index_traits(added, dims);
+        auto nearest_added = select_nearest_trait(added, dims);
+        if (incremental) {
+            report.mode = DistanceMode::INCREMENTAL;
+        }
+
+        // The state is only valid again once every voxel has been brought up to date. Unless it is kept for the
+        // next build, its rankings are only needed until the field is normalised.
+        state.source.reset();
+        bool keep_state = options.incremental && !table;
+        auto release_state = [&state, keep_state] {
+            if (!keep_state) {
+                state = {};
+            }
+        };
+        if (!incremental) {
+            state.dist.resize(grid_size);
+            state.second_dist.resize(grid_size);
+            state.trait.resize(grid_size);
+            state.second_trait.resize(grid_size);
+        }
+        RankedOutput ranks = {state.dist.data(), state.second_dist.data(), state.trait.data(), state.second_trait.data()};
+
+        size_t slab_rows = std::max<size_t>(1, DIST_SLAB_VOXELS / std::max<size_t>(row_size, 1));
+        size_t slab_size = slab_rows * row_size;
+        size_t num_slabs = slab_size ? (grid_size + slab_size - 1) / slab_size : 0;
+
+        // Volumes with few distinct attribute tuples rank each tuple once, voxels then copy their tuple's ranking
+        std::optional<UniqueTuples> unique;
+        if (!table && !incremental && traits.size() >= DIST_UNIQUE_MIN_TRAITS) {
+            unique = find_unique_tuples(columns, grid_size, slab_size, num_slabs, stop);
+        }
+        if (unique) {
+            rank_unique_tuples(*unique, columns, trait_set, nearest_trait, stop);
+            report.unique_tuples = unique->voxels.size();
+        }
+
+        std::atomic<size_t> voxels_done = 0;
+        auto advance = [&] (size_t count) {
+            auto done = voxels_done.fetch_add(count, std::memory_order_relaxed) + count;
+            if (progress) {
+                progress(static_cast<float>(done) / grid_size);
+            }
+        };
+
+        // Large volumes are built coarse to fine when someone wants to look at them early. Every level shows
+        // up as a preview and the voxels ranked for it are left alone by the levels after.
+        size_t preview_stride = 1;
+        if (options.preview && !table && !incremental && !unique) {
+            preview_stride = first_preview_stride(*data);
+        }
+        for (size_t stride = preview_stride; stride > 1; stride /= 2) {
+            rank_level(*data, columns, trait_set, nearest_trait, stride, stride == preview_stride, ranks, stop, advance);
+            if (stop.load(std::memory_order_relaxed)) {
+                release_state();
+                return false;
+            }
+            options.preview(make_preview(*data, state, traits, stride));
+        }
+
+        // Every slab keeps its own maximum, they are combined once all slabs are in
+        std::vector<float> slab_max(num_slabs, 0);
+
+        parallel_for(num_slabs, [&] (size_t slab) {
+            if (stop.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            size_t first = slab * slab_size;
+            size_t last = std::min(first + slab_size, grid_size);
+
+            // Points and polygons read two components even with a single attribute, the missing one stays 0
+            size_t num_comps = std::max<size_t>(dims, 2);
+            thread_local std::vector<float> pts, redo_pts;
+            thread_local std::vector<float> dists[2];
+            thread_local std::vector<uint32_t> winners[2];
+            thread_local std::vector<uint32_t> redo;
+            thread_local std::vector<uint64_t> keys;
+            pts.assign(num_comps * DIST_BLOCK_VOXELS, 0.0f);
+            redo_pts.assign(num_comps * DIST_BLOCK_VOXELS, 0.0f);
+            for (size_t k = 0; k < 2; k++) {
+                dists[k].resize(DIST_BLOCK_VOXELS);
+                winners[k].resize(DIST_BLOCK_VOXELS);
+            }
+            keys.resize(DIST_BLOCK_VOXELS);
+            RankedOutput scratch = {dists[0].data(), dists[1].data(), winners[0].data(), winners[1].data()};
+
+            // Ranks the voxels of a block listed in redo over all traits
+            auto rank_redo = [&] (RankedOutput out) {
+                if (redo.empty()) {
+                    return;
+                }
+                for (size_t dim = 0; dim < dims; dim++) {
+                    for (size_t k = 0; k < redo.size(); k++) {
+                        redo_pts[dim * DIST_BLOCK_VOXELS + k] = pts[dim * DIST_BLOCK_VOXELS + redo[k]];
+                    }
+                }
+                nearest_trait(trait_set, redo_pts.data(), DIST_BLOCK_VOXELS, redo.size(), scratch);
+                for (size_t k = 0; k < redo.size(); k++) {
+                    out.set(redo[k], scratch.get(k));
+                }
+            };
+
+            float max_dist = 0;
+            size_t skipped = 0;
+            for (size_t block = first; block < last; block += DIST_BLOCK_VOXELS) {
+                size_t count = std::min(DIST_BLOCK_VOXELS, last - block);
+                auto out = ranks + block;
+                if (unique) {
+                    tuple_keys(columns, block, count, keys.data());
+                    uint32_t tuple = unique->table.find(keys[0]);
+                    for (size_t j = 0; j < count; j++) {
+                        if (j > 0 && keys[j] != keys[j - 1]) {
+                            tuple = unique->table.find(keys[j]);
+                        }
+                        out.set(j, unique->ranks().get(tuple));
+                    }
+                    for (size_t j = 0; j < count; j++) {
+                        max_dist = std::max(out.dist[j], max_dist);
+                    }
+                    continue;
+                }
+
+                // Get the points in attribute space for these points in domain
+                for (size_t dim = 0; dim < dims; dim++) {
+                    columns[dim]->read(block, count, pts.data() + dim * DIST_BLOCK_VOXELS);
+                }
+
+                if (table) {
+                    lookup_distances(*table, pts.data(), DIST_BLOCK_VOXELS, count, out.dist, out.trait);
+                }
+                else if (!incremental && preview_stride == 1) {
+                    nearest_trait(trait_set, pts.data(), DIST_BLOCK_VOXELS, count, out);
+                }
+                else if (!incremental) {
+                    // Voxels whose coordinates are all even were ranked for the previews
+                    redo.clear();
+                    size_t x = block % row_size, row = block / row_size;
+                    bool odd_row = ((row % data->ny) | (row / data->ny)) & 1;
+                    for (size_t j = 0; j < count; j++) {
+                        if (odd_row || (x & 1)) {
+                            redo.push_back(static_cast<uint32_t>(j));
+                        }
+                        if (++x == row_size) {
+                            x = 0;
+                            row++;
+                            odd_row = ((row % data->ny) | (row / data->ny)) & 1;
+                        }
+                    }
+                    rank_redo(out);
+                    skipped += count - redo.size();
+                }
+                else {
+                    // Voxels that lost their winner or runner up have to rank all traits again, the others only
+                    // need to see where the added traits fall in their ranking
+                    redo.clear();
+                    for (size_t j = 0; j < count; j++) {
+                        auto trait = remap[out.trait[j]], second_trait = remap[out.second_trait[j]];
+                        if (trait == REMOVED_TRAIT || second_trait == REMOVED_TRAIT) {
+                            redo.push_back(static_cast<uint32_t>(j));
+                            continue;
+                        }
+                        out.trait[j] = trait;
+                        out.second_trait[j] = second_trait;
+                    }
+
+                    if (!added.empty()) {
+                        nearest_added(added, pts.data(), DIST_BLOCK_VOXELS, count, scratch);
+                        for (size_t j = 0; j < count; j++) {
+                            auto ranked = out.get(j);
+                            rank_trait(ranked, scratch.dist[j], scratch.trait[j]);
+                            rank_trait(ranked, scratch.second_dist[j], scratch.second_trait[j]);
+                            out.set(j, ranked);
+                        }
+                    }
+
+                    rank_redo(out);
+                }
+
+                for (size_t j = 0; j < count; j++) {
+                    max_dist = std::max(out.dist[j], max_dist);
+                }
+            }
+            slab_max[slab] = max_dist;
+            advance(last - first - skipped);
+        });
+
+        if (stop.load(std::memory_order_relaxed)) {
+            release_state();
+            return false;
+        }
+
+        float max_dist = 0;
+        for (auto slab_dist : slab_max) {
+            max_dist = std::max(slab_dist, max_dist);
+        }
+
+        if (table) {
+            measure_lookup_error(columns, traits, trait_set, nearest_trait, state, max_dist, report);
+        }
+        else if (keep_state) {
+            state.source = data;
+            state.comps = std::move(comps);
+            state.traits = traits;
+        }
+
+        // Normalize the field and colour every voxel by its nearest trait. A field where every voxel is on a trait
+        // stays 0 throughout.
+        float scale = max_dist > 0 ? DISTANCE_FIELD_ONE / max_dist : 0;
+        parallel_for(num_slabs, [&] (size_t slab) {
+            size_t first = slab * slab_size;
+            size_t last = std::min(first + slab_size, grid_size);
+            for (size_t i = first; i < last; i++) {
+                field[i] = static_cast<uint16_t>(state.dist[i] * scale + 0.5f);
+                color_ids[i] = static_cast<uint8_t>(traits[state.trait[i]].color_id);
+            }
+        });
+        release_state();
+
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        return true;
+    }
+}
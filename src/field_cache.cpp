@@ -0,0 +1,421 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "field_cache.h"
+#include "mapped_file.h"
+#include "parallel.h"
+
+constexpr char CACHE_MAGIC[4] = {'M', 'V', 'F', 'C'};
+constexpr uint32_t CACHE_VERSION = 2;
+constexpr uint32_t CACHE_BYTE_ORDER = 0x01020304;
+constexpr size_t CACHE_PAGE_SIZE = 4096;
+// Number of values copied between progress updates/cancellation checks
+constexpr size_t CACHE_CHUNK_VALUES = 1 << 22;
+
+namespace MVF {
+    struct CacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t num_fields;
+        uint32_t num_groups;
+        int32_t nx, ny, nz;
+        float origin[3];
+        float spacing[3];
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint64_t table_size; // Size of the field/group table that follows the header
+    };
+
+    struct CacheField {
+        std::string name;
+        FieldType type;
+        float min_val, max_val;
+        uint64_t offset; // Page aligned file offset of the column
+    };
+
+    struct CacheInfo {
+        CacheHeader header;
+        std::vector<CacheField> fields;
+        std::vector<std::pair<std::string, std::vector<std::string>>> groups;
+    };
+
+    static size_t align_to_page(size_t offset) {
+        return (offset + CACHE_PAGE_SIZE - 1) / CACHE_PAGE_SIZE * CACHE_PAGE_SIZE;
+    }
+
+    static bool get_source_stamp(const std::string& source, uint64_t& size, int64_t& mtime) {
+        std::error_code ec;
+        size = std::filesystem::file_size(source, ec);
+        if (ec) {
+            return false;
+        }
+
+        auto time = std::filesystem::last_write_time(source, ec);
+        if (ec) {
+            return false;
+        }
+
+        mtime = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    // Parses and validates the header and table of a mapped cache file
+    static bool parse_cache(const MappedFile& mapping, CacheInfo& info) {
+        const char* ptr = mapping.data();
+        const char* end = ptr + mapping.size();
+
+        if (mapping.size() < sizeof(CacheHeader)) {
+            return false;
+        }
+
+        auto& header = info.header;
+        std::memcpy(&header, ptr, sizeof(CacheHeader));
+        ptr += sizeof(CacheHeader);
+
+        if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION
+            || header.byte_order != CACHE_BYTE_ORDER || header.table_size > static_cast<size_t>(end - ptr)
+            || header.nx <= 0 || header.ny <= 0 || header.nz <= 0) {
+            return false;
+        }
+
+        end = ptr + header.table_size;
+        auto read = [&ptr, end] (auto& value) {
+            if (static_cast<size_t>(end - ptr) < sizeof(value)) {
+                return false;
+            }
+            std::memcpy(&value, ptr, sizeof(value));
+            ptr += sizeof(value);
+            return true;
+        };
+
+        auto read_string = [&ptr, end, &read] (std::string& str) {
+            uint32_t len;
+            if (!read(len) || static_cast<size_t>(end - ptr) < len) {
+                return false;
+            }
+            str.assign(ptr, len);
+            ptr += len;
+            return true;
+        };
+
+        size_t field_size = static_cast<size_t>(header.nx) * header.ny * header.nz;
+        info.fields.resize(header.num_fields);
+        for (auto& field : info.fields) {
+            uint32_t type;
+            if (!read_string(field.name) || !read(type) || !read(field.min_val) || !read(field.max_val) || !read(field.offset)) {
+                return false;
+            }
+
+            field.type = static_cast<FieldType>(type);
+            size_t column_bytes = field_size * get_field_type_size(field.type);
+            if (column_bytes == 0 || field.offset % CACHE_PAGE_SIZE != 0 || field.offset > mapping.size()
+                || mapping.size() - field.offset < column_bytes) {
+                return false;
+            }
+        }
+
+        info.groups.resize(header.num_groups);
+        for (auto& [name, comps] : info.groups) {
+            uint32_t count;
+            if (!read_string(name) || !read(count)) {
+                return false;
+            }
+
+            comps.resize(count);
+            for (auto& comp : comps) {
+                if (!read_string(comp)) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    std::string get_cache_filename(const std::string& source) {
+        return source + ".mvfc";
+    }
+
+    bool open_field_cache(const std::string& source, LoadProxy& proxy) {
+        uint64_t source_size;
+        int64_t source_mtime;
+        if (!get_source_stamp(source, source_size, source_mtime)) {
+            return false;
+        }
+
+        MappedFile mapping;
+        std::error_code ec;
+        auto cache_filename = get_cache_filename(source);
+        if (!std::filesystem::exists(cache_filename, ec) || !mapping.open(cache_filename)) {
+            return false;
+        }
+
+        CacheInfo info;
+        if (!parse_cache(mapping, info)) {
+#ifdef MVF_DEBUG
+            std::cerr << "Ignoring invalid field cache " << cache_filename << std::endl;
+#endif
+            return false;
+        }
+
+        if (info.header.source_size != source_size || info.header.source_mtime != source_mtime) {
+#ifdef MVF_DEBUG
+            std::cout << "Field cache " << cache_filename << " is stale" << std::endl;
+#endif
+            return false;
+        }
+
+        auto vol = std::make_shared<VolumeData>();
+        vol->filename = source;
+        vol->nx = info.header.nx;
+        vol->ny = info.header.ny;
+        vol->nz = info.header.nz;
+        vol->origin = Vector3f(info.header.origin[0], info.header.origin[1], info.header.origin[2]);
+        vol->spacing = Vector3f(info.header.spacing[0], info.header.spacing[1], info.header.spacing[2]);
+
+        for (auto& field : info.fields) {
+            vol->ranges[field.name] = {field.min_val, field.max_val};
+        }
+
+        for (auto& [name, comps] : info.groups) {
+            vol->groups[name] = comps;
+        }
+
+        proxy.filename = source;
+        proxy.data = vol;
+        proxy.format = VolumeFormat::FIELD_CACHE;
+        proxy.field_size = static_cast<size_t>(vol->nx) * vol->ny * vol->nz;
+        proxy.num_bytes_read = 0;
+        proxy.total_bytes = proxy.field_size * info.fields.size();
+        proxy.total_fields_read = 0;
+        proxy.total_fields = info.fields.size();
+        proxy.file_offset = 0;
+        proxy.field_index.clear();
+        proxy.pending_fields.clear();
+        proxy.read_failed = false;
+        proxy.thread_dispatched = false;
+        proxy.stop_requested = false;
+        proxy.load_finished = false;
+
+        // The table already says where every column is, so the fields are listed without reading them
+        for (auto& field : info.fields) {
+            vol->scalars[field.name];
+            proxy.field_index.push_back({.name = field.name, .comps = 1, .type = {}, .begin = field.offset,
+                .end = field.offset + proxy.field_size * get_field_type_size(field.type)});
+        }
+
+        return true;
+    }
+
+    bool write_field_cache(const std::string& source, const VolumeData& data, const std::atomic<bool>* stop) {
+        CacheHeader header{};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.byte_order = CACHE_BYTE_ORDER;
+        header.num_fields = data.scalars.size();
+        header.num_groups = data.groups.size();
+        header.nx = data.nx;
+        header.ny = data.ny;
+        header.nz = data.nz;
+        header.origin[0] = data.origin.x;
+        header.origin[1] = data.origin.y;
+        header.origin[2] = data.origin.z;
+        header.spacing[0] = data.spacing.x;
+        header.spacing[1] = data.spacing.y;
+        header.spacing[2] = data.spacing.z;
+        if (!get_source_stamp(source, header.source_size, header.source_mtime)) {
+            return false;
+        }
+
+        std::string table;
+        auto write = [&table] (const auto& value) {
+            table.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+
+        auto write_string = [&table, &write] (const std::string& str) {
+            write(static_cast<uint32_t>(str.size()));
+            table.append(str);
+        };
+
+        // The table size is known before the column offsets are, as each entry has a fixed size apart from names
+        size_t table_size = 0;
+        for (auto& [name, _] : data.scalars) {
+            table_size += 2 * sizeof(uint32_t) + name.size() + 2 * sizeof(float) + sizeof(uint64_t);
+        }
+        for (auto& [name, comps] : data.groups) {
+            table_size += 2 * sizeof(uint32_t) + name.size();
+            for (auto& comp : comps) {
+                table_size += sizeof(uint32_t) + comp.size();
+            }
+        }
+        header.table_size = table_size;
+
+        size_t field_size = static_cast<size_t>(data.nx) * data.ny * data.nz;
+        size_t offset = align_to_page(sizeof(CacheHeader) + table_size);
+        std::vector<const ScalarField*> columns;
+        std::vector<uint64_t> offsets;
+
+        for (auto& [name, values] : data.scalars) {
+            if (values.size() != field_size) {
+                return false;
+            }
+
+            // Columns keep the storage type of the field
+            auto [mn, mx] = values.minmax();
+            write_string(name);
+            write(static_cast<uint32_t>(values.type()));
+            write(mn);
+            write(mx);
+            write(static_cast<uint64_t>(offset));
+
+            columns.push_back(&values);
+            offsets.push_back(offset);
+            offset = align_to_page(offset + values.byte_size());
+        }
+
+        for (auto& [name, comps] : data.groups) {
+            write_string(name);
+            write(static_cast<uint32_t>(comps.size()));
+            for (auto& comp : comps) {
+                write_string(comp);
+            }
+        }
+
+        // Write next to the final name and rename once complete, so a half written cache is never picked up
+        auto cache_filename = get_cache_filename(source);
+        auto tmp_filename = cache_filename + ".tmp";
+        {
+            std::ofstream file(tmp_filename, std::ios::binary | std::ios::trunc);
+            if (!file) {
+#ifdef MVF_DEBUG
+                std::cerr << "Unable to create field cache " << tmp_filename << std::endl;
+#endif
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(table.data(), table.size());
+
+            // Columns go out in chunks so a stop request never waits for a whole field to be written
+            std::vector<char> padding(CACHE_PAGE_SIZE, 0);
+            bool stopped = false;
+            for (size_t i = 0; i < columns.size() && !stopped; i++) {
+                auto pos = static_cast<size_t>(file.tellp());
+                file.write(padding.data(), offsets[i] - pos);
+
+                auto column = static_cast<const char*>(columns[i]->data());
+                size_t chunk_bytes = CACHE_CHUNK_VALUES * columns[i]->element_size();
+                for (size_t first = 0; first < columns[i]->byte_size() && file; first += chunk_bytes) {
+                    if (stop && stop->load(std::memory_order_relaxed)) {
+                        stopped = true;
+                        break;
+                    }
+                    file.write(column + first, std::min(chunk_bytes, columns[i]->byte_size() - first));
+                }
+            }
+
+            if (!file || stopped) {
+                file.close();
+                std::filesystem::remove(tmp_filename);
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmp_filename, cache_filename, ec);
+        if (ec) {
+            std::filesystem::remove(tmp_filename, ec);
+            return false;
+        }
+
+#ifdef MVF_DEBUG
+        std::cout << "Wrote field cache " << cache_filename << std::endl;
+#endif
+        return true;
+    }
+
+    void LoadProxy::read_cache() {
+        try {
+            MappedFile mapping;
+            CacheInfo info;
+            if (!mapping.open(get_cache_filename(filename)) || !parse_cache(mapping, info)) {
+                read_failed = true;
+                return;
+            }
+
+            struct CopyTask {
+                const char* src;
+                char* dest;
+                size_t count;
+                size_t elem_size;
+            };
+
+            std::vector<CopyTask> tasks;
+            for (auto idx : pending_fields) {
+                auto it = std::ranges::find(info.fields, field_index[idx].name, &CacheField::name);
+                if (it == info.fields.end()) {
+                    std::cerr << "Field " << field_index[idx].name << " is missing from the field cache" << std::endl;
+                    read_failed = true;
+                    return;
+                }
+
+                auto& field = *it;
+                auto& dest = data->scalars[field.name];
+                dest = ScalarField(field.type, field_size);
+                auto elem_size = dest.element_size();
+                auto src = mapping.data() + field.offset;
+                auto dest_ptr = static_cast<char*>(dest.data());
+                for (size_t offset = 0; offset < field_size; offset += CACHE_CHUNK_VALUES) {
+                    tasks.push_back({src + offset * elem_size, dest_ptr + offset * elem_size,
+                        std::min(CACHE_CHUNK_VALUES, field_size - offset), elem_size});
+                }
+            }
+
+            parallel_for(tasks.size(), [this, &tasks] (size_t i) {
+                if (stop_requested.load(std::memory_order_relaxed)) {
+                    return;
+                }
+
+                auto num_bytes = tasks[i].count * tasks[i].elem_size;
+                {
+                    PhaseTimer timer(stats, LoadPhase::READ);
+                    prefault(tasks[i].src, num_bytes);
+                    stats.add_bytes(num_bytes);
+                }
+
+                PhaseTimer timer(stats, LoadPhase::PARSE);
+                std::memcpy(tasks[i].dest, tasks[i].src, num_bytes);
+                report_values(tasks[i].count);
+            });
+
+            if (stop_requested.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            finish_field_load();
+        } catch (const std::exception& e) {
+            std::cerr << "Error while loading field cache: " << e.what() << std::endl;
+            read_failed = true;
+        }
+    }
+
+    void LoadProxy::write_cache() {
+        // Written in the background once the volume is complete. The volume is not modified after loading,
+        // so sharing it with the UI is fine.
+        if (cache_thread.joinable()) {
+            cache_thread.join();
+        }
+        stop_cache.store(false, std::memory_order_relaxed);
+        cache_thread = std::thread([this, source = filename, vol = data] {
+            if (!write_field_cache(source, *vol, &stop_cache)) {
+#ifdef MVF_DEBUG
+                std::cerr << "Field cache for " << source << " was not written" << std::endl;
+#endif
+            }
+        });
+    }
+}
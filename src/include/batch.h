@@ -0,0 +1,20 @@
+#pragma once
+
+namespace MVF {
+    // Builds a distance field without a window or GL context:
+    //     mvf --batch <volume> <traits.json> [--out <prefix>] [--threads <n>] [--repeat <n>] [--lookup-table]
+    // The JSON file lists the attribute components and the traits in attribute units:
+    //     {
+    //         "components": ["density", "velocity_X"],
+    //         "traits": [
+    //             {"type": "point", "at": [0.5, 1.0], "color": 0},
+    //             {"type": "interval", "range": [0.1, 0.4], "color": 1},
+    //             {"type": "polygon", "min": [0.1, 0.2], "max": [0.3, 0.6], "color": 2},
+    //             {"type": "box", "ranges": [[0.1, 0.3], [0.2, 0.6]], "color": 3}
+    //         ]
+    //     }
+    // Intervals need a single component and polygons two. The normalised field and the colour ids are written
+    // next to each other as <prefix>_<nx>x<ny>x<nz>_uint16.raw and <prefix>_colors_<nx>x<ny>x<nz>_uint8.raw,
+    // which open again as raw volumes. Returns the exit code of the process.
+    int run_batch(int argc, char* argv[]);
+}
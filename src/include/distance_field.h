@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "vtk.h"
+#include "attrib.h"
+
+namespace MVF {
+    // Called with the fraction of voxels done, from whichever worker finished a slab
+    using DistanceProgress = std::function<void(float fraction)>;
+
+    // What a build leaves behind for the next one: the volume, attribute components and traits it was for,
+    // and per voxel the squared distance and index of the nearest trait and of the runner up
+    struct DistanceState {
+        std::weak_ptr<const VolumeData> source;
+        std::vector<std::string> comps;
+        std::vector<Trait> traits;
+        std::vector<float> dist, second_dist;
+        std::vector<uint32_t> trait, second_trait;
+    };
+
+    // Field value at the largest distance, the field is stored as 16 bit unsigned normalised integers so that it
+    // uploads as an R16 texture
+    constexpr uint16_t DISTANCE_FIELD_ONE = UINT16_MAX;
+
+    // A coarse version of a field being built, made of every stride-th voxel along each axis and normalised by
+    // the largest distance among those voxels
+    struct DistancePreview {
+        size_t stride;
+        size_t nx, ny, nz;
+        std::vector<uint16_t> field;
+        std::vector<uint8_t> color_ids;
+    };
+
+    // Called from a worker with each preview as it is done, coarsest first
+    using DistancePreviewHandler = std::function<void(DistancePreview&& preview)>;
+
+    struct DistanceOptions {
+        // With 1 to 3 components, rank the traits on a regular grid over the attribute ranges once and
+        // interpolate that per voxel instead of ranking them at every voxel
+        bool lookup_table = false;
+        // Keep the two nearest traits of every voxel in the state (16 bytes per voxel) so that the next build
+        // only applies the trait changes. Without it the state is emptied once the field is done.
+        bool incremental = false;
+        // If set, large volumes are built coarse to fine: every 2^k-th voxel along each axis first, halving the
+        // stride down to 2 with a preview after each level. Voxels ranked for a level are not ranked again.
+        DistancePreviewHandler preview;
+    };
+
+    enum class DistanceMode {
+        FULL,
+        INCREMENTAL,
+        LOOKUP_TABLE
+    };
+
+    // How a build went. For lookup tables, the error is measured against exact distances at a sample of
+    // voxels, in units of the normalised field.
+    struct DistanceReport {
+        DistanceMode mode = DistanceMode::FULL;
+        double seconds = 0;
+        size_t table_size = 0; // Nodes per axis
+        size_t unique_tuples = 0; // Distinct attribute tuples ranked, when voxels were found to share them
+        size_t samples = 0;
+        float max_error = 0, mean_error = 0;
+        float color_mismatch = 0; // Fraction of samples coloured by another trait than the exact path gives
+
+        std::string summary() const;
+    };
+
+    // Computes, for every voxel of data, the distance to the nearest trait in attribute space normalised by the
+    // largest such distance, along with the index of that trait's colour in global_color_pallete. The volume is
+    // split into slabs of whole rows that a pool of workers takes in turn, every voxel is computed on its own
+    // so the result does not depend on the number of threads. Within a slab, voxels are evaluated 8 or 16 at a
+    // time with AVX2/AVX-512 when the CPU has them.
+    // With thousands of traits, each voxel instead searches a hierarchy of trait bounds.
+    // Integer attributes whose voxels keep repeating the same few tuples have each distinct tuple ranked once.
+    // If incremental builds are asked for and state holds a build for the same volume and components, only the
+    // trait changes are applied: added traits are ranked against every voxel once, and only voxels whose winner
+    // or runner up was removed or edited go over all traits again. Lookup table builds are approximate and leave
+    // state empty, as do cancelled ones, so the next call starts over. Returns false if stop was raised before
+    // all voxels were done.
+    bool compute_distance_field(const std::shared_ptr<VolumeData>& data, const std::vector<AxisDescMeta>& attrib_comps,
+        const std::vector<Trait>& traits, std::vector<uint16_t>& field, std::vector<uint8_t>& color_ids,
+        DistanceState& state, const DistanceOptions& options, DistanceReport& report, const std::atomic<bool>& stop,
+        const DistanceProgress& progress);
+}
@@ -2,12 +2,15 @@
 
 #include <variant>
 #include <atomic>
+#include <list>
 #include <mutex>
 #include "vtk.h"
 #include "math_utils.h"
 #include "shapes.h"
 #include "pipeline.h"
 #include "attrib.h"
+#include "distance_field.h"
+#include "isosurface.h"
 #include "widgets.h"
 
 enum class EntityMode {
@@ -109,6 +112,7 @@ namespace MVF {
         void set_box_mode();
         void set_vector_mode(const std::string& field1, const std::string& field2);
         void set_vector_mode(const std::string& field1, const std::string& field2, const std::string& field3);
+        void set_vector_mode(const std::string& group);
         void set_scalar_slice(const std::string& field, int axis = 2);
         void set_slice_position(float t);
         void set_slice_axis(int axis);
@@ -160,8 +164,26 @@ namespace MVF {
     };
 
     class FieldEntity : Entity {
+        // An isosurface on the GPU, with the grid and isovalue it was extracted for. Surfaces from the compute
+        // shaders are not indexed, their draw command is left in indirect by the GPU and index_count only
+        // counts their vertices.
+        struct SurfaceBuffers {
+            GLuint vao = 0, vbo = 0, ebo = 0, indirect = 0;
+            size_t index_count = 0;
+            size_t grid_version = 0;
+            float iso_value = 0;
+            bool gpu = false;
+        };
+
+        // A grid sampled in the background, at the level it was sampled at
+        struct GridLevel {
+            std::shared_ptr<const IsoGrid> grid;
+            size_t level;
+        };
+
     public:
         FieldEntity();
+        ~FieldEntity();
         void init(VolumeEntity* geometry_entity);
         void set_traits(const std::vector<AxisDescMeta>& attrib_comps, const std::vector<Trait>& traits);
         void complete_set_traits();
@@ -169,20 +191,60 @@ namespace MVF {
         void clear_traits();
         void set_isovalue(float value);
         void set_apply_color(bool apply_color);
+        void set_lookup_table(bool lookup_table);
+        void set_incremental(bool incremental);
+        void set_gpu_extraction(bool gpu_extraction);
+        void set_lod_resolution(bool lod_resolution);
+        // Shows the latest preview of a field still being computed, returns whether there was one
+        bool update_preview();
+        // Shows the latest grid refined in the background, returns whether there was one
+        bool update_grid();
         friend FieldRenderer;
     
     private:
     
-        GLuint vao, vbo;
-        GLuint tex3d, tex3d_col;
-        Vector3f steps;
-        const size_t res_x = 100, res_y = 100, res_z = 100;
         float iso_value = 0;
-        std::vector<Vertex> points;
-        std::vector<float> field;
-        std::vector<Vector3f> color_field;
+        std::shared_ptr<const IsoGrid> grid;
+        // The grid holds the field at its own resolution halved grid_level times along each axis, unless it was
+        // sampled from a preview. Without LOD the level aimed for is 0, with it the level is picked from the
+        // size of a cell on screen and the triangle budget. Grids slow to sample are shown coarser first and
+        // refined in the background. Level 0 is native_grid itself, the only copy of the finished field, and
+        // the coarser levels are sampled from it.
+        bool lod_resolution = false;
+        bool field_grid = false;
+        size_t grid_level = 0;
+        size_t target_level = 0;
+        std::thread grid_thread;
+        std::mutex grid_lock;
+        std::optional<GridLevel> pending_grid;
+        std::atomic<bool> stop_refining = false;
+        // Bumped whenever the grid is sampled again, surfaces of older versions are never drawn
+        size_t grid_version = 0;
+        // Most recently drawn first
+        std::list<SurfaceBuffers> surfaces;
+        bool gpu_extraction = false;
+        // The grid as integer textures for the compute shaders, uploaded when they first need a new version
+        GLuint grid_tex, grid_col_tex;
+        size_t grid_tex_version = 0;
+        // Indices of the bricks the surface passes through, one work group each
+        std::vector<uint32_t> active_bricks;
+        GLuint brick_buffer;
+        // Per cell triangle counts, then the sums of each block of them, and so on up to the total
+        std::vector<GLuint> scan_buffers;
+        std::vector<size_t> scan_sizes;
+        // Written by the worker, which moves them into native_grid once the field is done. A finished field keeps
+        // 3 bytes per voxel (a distance and a palette index), coarser LOD grids add up to an eighth of that. The
+        // build itself needs 16 bytes per voxel while it ranks the traits, kept in dist_state when incremental.
+        std::vector<uint16_t> field;
+        std::vector<uint8_t> color_ids;
+        std::shared_ptr<const IsoGrid> native_grid;
         std::vector<AxisDescMeta> attrib_comps;
         std::vector<Trait> traits;
+        DistanceState dist_state;
+        DistanceOptions dist_options;
+        DistanceReport dist_report;
+        std::mutex preview_lock;
+        std::optional<DistancePreview> pending_preview;
         VolumeEntity* geometry_entity;
         std::mutex dist_fld_lock;
         std::thread worker_thread; 
@@ -191,10 +253,18 @@ namespace MVF {
         bool is_apply_color = false;
         std::atomic<bool> stop_requested = false; 
 
-        void create_voxel_grid();
         void create_buffers();
-        void build_distance_field();
-        void build_texture();
+        void build_distance_field(DistanceOptions options);
+        void build_grid();
+        void set_grid(std::shared_ptr<const IsoGrid> new_grid);
+        void regrid(size_t level);
+        void stop_refinement();
+        void update_level(const Matrix4f& mvp, int width, int height);
+        void create_surface_buffers(SurfaceBuffers& surface);
+        void extract_surface(SurfaceBuffers& surface);
+        void extract_surface_gpu(SurfaceBuffers& surface);
+        void upload_grid();
+        SurfaceBuffers& get_surface();
         
         void draw() override;
     };
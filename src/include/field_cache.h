@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include "vtk.h"
+
+namespace MVF {
+    // A field cache is a sidecar file (<source>.mvfc) holding the already parsed fields of a volume as
+    // page aligned columns in their storage type, along with the volume geometry and per-field value
+    // ranges. It is only used while the size and modification time of the source file match the ones
+    // recorded in it. Raw volumes are not cached, their conversion is no slower than reading a cache.
+    std::string get_cache_filename(const std::string& source);
+    bool open_field_cache(const std::string& source, LoadProxy& proxy);
+    // Raising stop abandons the write, leaving no cache behind
+    bool write_field_cache(const std::string& source, const VolumeData& data, const std::atomic<bool>* stop = nullptr);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include "math_utils.h"
+
+namespace MVF {
+    // Cells along each axis of a brick, a compute work group extracts one brick
+    constexpr size_t ISO_BRICK_CELLS = 8;
+
+    // Value ranges of the bricks of a grid at level 0, and of blocks of 2 x 2 x 2 nodes of the level below at
+    // each level above, up to a single node. Brick (bx, by, bz) holds the cells from (bx, by, bz) *
+    // ISO_BRICK_CELLS on and the samples at their corners.
+    struct IsoBrickLevel {
+        size_t nx = 0, ny = 0, nz = 0;
+        std::vector<uint16_t> min, max;
+    };
+
+    // A scalar field sampled on a regular grid, with the colour index of each sample. Sample (i, j, k) sits at
+    // origin + (i, j, k) * step in object space. Extractors only visit the bricks the surface can pass through
+    // when the grid has its brick levels.
+    struct IsoGrid {
+        size_t nx = 0, ny = 0, nz = 0;
+        Vector3f origin, step;
+        std::vector<uint16_t> values;
+        std::vector<uint8_t> color_ids;
+        std::vector<IsoBrickLevel> bricks;
+    };
+
+    struct IsoVertex {
+        float x, y, z;
+        float nx, ny, nz;
+        uint32_t color_id;
+    };
+
+    // Triangles as 3 indices each into vertices, vertices on an edge shared by several cells appear once
+    struct IsoMesh {
+        std::vector<IsoVertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // Samples a field of nx * ny * nz voxels on a grid of res_x * res_y * res_z points at the centres of as
+    // many equal cells of the volume: values are interpolated linearly between voxel centres the way a texture
+    // is, and colours taken from the nearest voxel. At the field's own resolution the grid is the field.
+    // Raising stop leaves the z slices not yet started unsampled, the grid is then only fit to be dropped.
+    void resample_field(size_t nx, size_t ny, size_t nz, const uint16_t* field, const uint8_t* color_ids,
+        size_t res_x, size_t res_y, size_t res_z, IsoGrid& grid, const std::atomic<bool>* stop = nullptr);
+
+    // Bricks along an axis of n samples
+    size_t brick_count(size_t n);
+
+    // Builds the brick levels of grid from its values, to be called again whenever they change. As above,
+    // raising stop leaves them incomplete.
+    void build_bricks(IsoGrid& grid, const std::atomic<bool>* stop = nullptr);
+
+    // Indices bx + (by + bz * by_count) * bx_count of the bricks with samples on both sides of threshold, in
+    // ascending order. Every brick is listed when the grid has no brick levels.
+    void find_active_bricks(const IsoGrid& grid, int32_t threshold, std::vector<uint32_t>& bricks);
+
+    // Samples at or below this value are inside the surface at iso_value, given in units of the normalised field
+    int32_t iso_threshold(float iso_value);
+
+    // Marching cubes over grid at iso_value, given in units of the normalised field. Samples at or below
+    // iso_value are inside and only the bricks found by find_active_bricks are visited. Slabs of cells are
+    // extracted in parallel, each vertex carries the gradient of the field as its normal and the colour of the
+    // inner end of its edge. The mesh is the same for any number of threads.
+    void extract_isosurface(const IsoGrid& grid, float iso_value, IsoMesh& mesh);
+}
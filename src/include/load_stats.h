@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace MVF {
+    enum class LoadPhase {
+        HEADER,  // Header parsing and the indexing pass over the file
+        READ,    // Getting bytes off the disk (stream reads, faulting in mapped pages)
+        PARSE,   // Turning bytes into values (text parsing, byteswaps, inflating)
+        FINALIZE // Wrapping up once every value is in
+    };
+
+    // Throughput counters of a load. Workers add to them while the UI polls, so everything is atomic.
+    // Phase times are summed over every thread taking part, reads overlap with parsing, so they can add up
+    // to more than the elapsed time.
+    class LoadStats {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // Clears the counters and restarts the clock
+        void start();
+        // Counts everything since start() as header parsing
+        void finish_header();
+
+        void add_bytes(size_t count);
+        void add_values(size_t count);
+        void add_time(LoadPhase phase, Clock::duration time);
+
+        size_t bytes_read() const;
+        size_t values_parsed() const;
+        double elapsed() const;
+        double phase_time(LoadPhase phase) const;
+        double mb_per_sec() const;
+        double values_per_sec() const;
+        // Seconds left, extrapolated from the fraction done so far (negative while unknown)
+        double eta(double fraction) const;
+
+        std::string progress_text(double fraction) const;
+        std::string summary() const;
+
+    private:
+        Clock::time_point start_time = Clock::now();
+        std::atomic<size_t> bytes = 0;
+        std::atomic<size_t> values = 0;
+        std::array<std::atomic<int64_t>, 4> phase_ns{};
+    };
+
+    // Adds the time spent in a scope to one phase of a load
+    class PhaseTimer {
+    public:
+        PhaseTimer(LoadStats& stats, LoadPhase phase) : stats(stats), phase(phase), begin(LoadStats::Clock::now()) {}
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+        ~PhaseTimer() {
+            stats.add_time(phase, LoadStats::Clock::now() - begin);
+        }
+
+    private:
+        LoadStats& stats;
+        LoadPhase phase;
+        LoadStats::Clock::time_point begin;
+    };
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace MVF {
+    // Read-only memory mapping of an entire file
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        ~MappedFile();
+
+        bool open(const std::string& filename);
+        void close();
+        bool is_open() const;
+        const char* data() const;
+        size_t size() const;
+
+    private:
+        const char* base = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        void* file_handle = nullptr;
+        void* map_handle = nullptr;
+#endif
+    };
+
+    // Touches every page of [ptr, ptr + size). A mapping is faulted in lazily by whoever reads it first, this
+    // pulls the pages in up front so time spent waiting on the disk can be told apart from conversion time.
+    void prefault(const char* ptr, size_t size);
+}
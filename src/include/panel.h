@@ -2,6 +2,7 @@
 
 #include <gtkmm.h>
 #include <memory>
+#include <functional>
 #include "handler.h"
 #include "vtk.h"
 #include "attrib.h"
@@ -10,8 +11,26 @@
 class MainWindow;
 
 class MVFPanel : public Gtk::Frame {
+public:
+    // Outcome of asking for the selected fields to be in memory
+    enum class FieldRequest {
+        READY,   // Already loaded, the selection can be applied
+        PENDING, // Loading in the background, on_loaded is called once done
+        BUSY     // Another load is running, the selection is rejected
+    };
+    using FieldRequester = std::function<FieldRequest(const std::vector<std::string>& names, std::function<void()> on_loaded)>;
+
+    void set_field_requester(FieldRequester requester) {
+        field_requester = requester;
+    }
+
 protected:
     std::shared_ptr<MVF::VolumeData> data;
+    FieldRequester field_requester;
+
+    FieldRequest request_fields(const std::vector<std::string>& names, std::function<void()> on_loaded) {
+        return field_requester ? field_requester(names, on_loaded) : FieldRequest::READY;
+    }
 };
 
 class SpatialPanel : public MVFPanel {
@@ -79,6 +98,7 @@ public:
     void clear_traits();
     void set_traits(const std::vector<MVF::AxisDescMeta>& attrib_comps, const std::vector<MVF::Trait>& traits);
     void complete_set_traits();
+    void update_preview();
     void enable_panel();
     void disable_panel();
 private:
@@ -87,4 +107,12 @@ private:
     Gtk::ComboBoxText rep_menu;
     Slider iso_slider;
     Gtk::CheckButton apply_color;
+    Gtk::CheckButton lookup_table;
+    Gtk::CheckButton incremental;
+    Gtk::CheckButton gpu_extraction;
+    Gtk::CheckButton lod_resolution;
+    // Polls for grids refined in the background while the panel is enabled
+    sigc::connection refine_conn;
+
+    bool update_grid();
 };
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MVF {
+    inline size_t hardware_threads() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Workers a parallel_for uses unless told otherwise, 0 for one per hardware thread
+    inline std::atomic<size_t> worker_count = 0;
+
+    inline size_t default_workers() {
+        auto count = worker_count.load(std::memory_order_relaxed);
+        return count ? count : hardware_threads();
+    }
+
+    // Runs task(i) for every i in [0, count). Tasks are handed out dynamically so uneven tasks
+    // still keep every worker busy. The calling thread takes part in the work.
+    template <typename F>
+    void parallel_for(size_t count, F&& task, size_t num_threads = default_workers()) {
+        num_threads = std::min(num_threads, count);
+        if (num_threads <= 1) {
+            for (size_t i = 0; i < count; i++) {
+                task(i);
+            }
+            return;
+        }
+
+        std::atomic<size_t> next_task = 0;
+        auto worker = [&] {
+            for (size_t i = next_task.fetch_add(1, std::memory_order_relaxed); i < count;
+                i = next_task.fetch_add(1, std::memory_order_relaxed)) {
+                task(i);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads - 1);
+        for (size_t t = 1; t < num_threads; t++) {
+            workers.emplace_back(worker);
+        }
+        worker();
+
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    // Workers kept alive across many short parallel loops, for hot paths where starting and joining threads
+    // for every parallel_for would cost as much as the work. run() is called from one thread at a time.
+    class WorkerPool {
+    public:
+        explicit WorkerPool(size_t num_threads = default_workers()) {
+            for (size_t t = 1; t < num_threads; t++) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // Runs task(i) for every i in [0, count) like parallel_for, the calling thread takes part in the work
+        template <typename F>
+        void run(size_t count, F&& task) {
+            if (workers.empty() || count <= 1) {
+                for (size_t i = 0; i < count; i++) {
+                    task(i);
+                }
+                return;
+            }
+
+            std::function<void(size_t)> job_task(std::ref(task));
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                job = &job_task;
+                job_count = count;
+                next_task.store(0, std::memory_order_relaxed);
+                busy = workers.size();
+                generation++;
+            }
+            wake.notify_all();
+            take_tasks(job_task, count);
+
+            std::unique_lock<std::mutex> guard(lock);
+            done.wait(guard, [this] { return busy == 0; });
+            job = nullptr;
+        }
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex lock;
+        std::condition_variable wake, done;
+        const std::function<void(size_t)>* job = nullptr;
+        size_t job_count = 0;
+        size_t busy = 0;
+        size_t generation = 0;
+        bool stopping = false;
+        std::atomic<size_t> next_task = 0;
+
+        void take_tasks(const std::function<void(size_t)>& task, size_t count) {
+            for (size_t i = next_task.fetch_add(1, std::memory_order_relaxed); i < count;
+                i = next_task.fetch_add(1, std::memory_order_relaxed)) {
+                task(i);
+            }
+        }
+
+        void work() {
+            size_t seen = 0;
+            std::unique_lock<std::mutex> guard(lock);
+            while (true) {
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+                auto task = job;
+                auto count = job_count;
+
+                guard.unlock();
+                take_tasks(*task, count);
+                guard.lock();
+                if (--busy == 0) {
+                    done.notify_one();
+                }
+            }
+        }
+    };
+}
@@ -11,6 +11,10 @@ namespace MVF {
         ISO,
         SLICE,
         DVR,
+        ISO_CLASSIFY,
+        ISO_SCAN,
+        ISO_SCAN_ADD,
+        ISO_EMIT,
 
         // Attribute domain
         AXIS = 0,
@@ -25,6 +29,7 @@ namespace MVF {
         Pipeline(PipelineType type); 
         Pipeline(const std::string& vs_file, const std::string& fs_file, PipelineType type);
         Pipeline(const std::string& vs_file, const std::string& gs_file, const std::string& fs_file, PipelineType type);
+        Pipeline(const std::string& cs_file, PipelineType type);
 
         static std::vector<Pipeline*> init_pipelines(bool is_spatial_pipeline = true);
 
@@ -34,6 +39,8 @@ namespace MVF {
     private:
         void add_shader(const char* shader_text, GLenum shader_type); 
         void compile_shaders(const std::string& vs_file, const std::string& gs_file, const std::string& fs_file); 
+        void compile_compute_shader(const std::string& cs_file);
+        void link_program();
     };
 
     struct VecGlyphPipeline : Pipeline {
@@ -76,13 +83,32 @@ namespace MVF {
 
     struct IsoPipeline: Pipeline {
         GLuint uMVP, uM;
-        GLuint uIsoValue, uOrigin;
-        GLuint uLimits, uSpacing;
-        GLuint uSteps;
         GLuint uLightPos, uViewPos;
         GLuint uApplyColor;
         IsoPipeline();    
     };
+
+    // Marching cubes in compute shaders: cells are classified, the triangle counts scanned and the triangles
+    // of every cell written out after those of the cells before it. A work group takes one of the bricks the
+    // surface passes through.
+    struct IsoClassifyPipeline: Pipeline {
+        GLuint uDims, uThreshold;
+        GLuint uBricks, uBrickCount;
+        IsoClassifyPipeline();
+    };
+
+    // Exclusive prefix sums over blocks of 1024 values, and the adding of scanned block sums back in
+    struct IsoScanPipeline: Pipeline {
+        GLuint uCount;
+        IsoScanPipeline(const std::string& cs_file, PipelineType type);
+    };
+
+    struct IsoEmitPipeline: Pipeline {
+        GLuint uDims, uThreshold;
+        GLuint uBricks, uBrickCount;
+        GLuint uIsoValue, uOrigin, uStep;
+        IsoEmitPipeline();
+    };
     
     struct ColorPipeline: Pipeline {
         GLuint uAlpha;
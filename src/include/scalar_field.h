@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <variant>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace MVF {
+    // Types a field can be stored as. Integer data up to 16 bits keeps its source type, everything else
+    // is widened (or narrowed) to float. The order matches the alternatives of ScalarField's storage.
+    enum class FieldType {
+        FLOAT32,
+        UINT8,
+        INT8,
+        UINT16,
+        INT16
+    };
+
+    size_t get_field_type_size(FieldType type);
+
+    // A scalar field kept at its native precision. Consumers read it as floats, either a value at a time,
+    // in blocks through read(), or with visit() which hands a typed pointer to a generic callable so hot
+    // loops are compiled once per storage type.
+    class ScalarField {
+    public:
+        ScalarField() = default;
+        ScalarField(FieldType type, size_t size);
+        explicit ScalarField(std::vector<float>&& values);
+
+        FieldType type() const;
+        size_t size() const;
+        size_t element_size() const;
+        size_t byte_size() const;
+        bool empty() const;
+
+        void* data();
+        const void* data() const;
+
+        // Typed access, T must be the storage type
+        template <typename T>
+        T* values() {
+            return std::get<std::vector<T>>(storage).data();
+        }
+
+        template <typename T>
+        const T* values() const {
+            return std::get<std::vector<T>>(storage).data();
+        }
+
+        float operator[](size_t i) const {
+            return std::visit([i] (auto& values) {
+                return static_cast<float>(values[i]);
+            }, storage);
+        }
+
+        // Converts count values starting at first into dest
+        void read(size_t first, size_t count, float* dest) const;
+        std::vector<float> to_float() const;
+        std::pair<float, float> minmax() const;
+
+        template <typename F>
+        decltype(auto) visit(F&& f) const {
+            return std::visit([&f] (auto& values) -> decltype(auto) {
+                return f(values.data());
+            }, storage);
+        }
+
+    private:
+        std::variant<std::vector<float>, std::vector<uint8_t>, std::vector<int8_t>, std::vector<uint16_t>,
+            std::vector<int16_t>> storage;
+    };
+}
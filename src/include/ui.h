@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <functional>
@@ -29,7 +30,10 @@ private:
     };
 
     void on_file_open();
+    void start_file_load(const std::string& filename, std::unique_ptr<MVF::LoadProxy> proxy);
     bool file_load_handler();
+    MVFPanel::FieldRequest request_fields(const std::vector<std::string>& names, std::function<void()> on_loaded);
+    bool field_load_handler();
     bool generic_async_handler();
     bool on_window_close();
     bool on_key_press();
@@ -51,10 +55,12 @@ private:
     bool show_plot = true;
     bool is_async_ui_state = false;
     bool disable_set_plot = true;
-    float async_progress = 0;
+    std::atomic<float> async_progress = 0; // Written by worker threads through advance_ui_clock
 
     sigc::connection file_loader_conn;
     std::unique_ptr<MVF::LoadProxy> loader;
+    std::unique_ptr<RawImportDialog> raw_dialog;
+    std::function<void()> on_fields_loaded;
     std::shared_ptr<MVF::VolumeData> data;
     std::string vtk_filename;
 
@@ -10,14 +10,57 @@
 #include <memory>
 #include <thread>
 #include "math_utils.h"
+#include "scalar_field.h"
+#include "load_stats.h"
 
 namespace MVF {
+    enum class VolumeFormat {
+        VTK_ASCII,
+        VTK_BINARY,
+        VTI,
+        RAW,
+        FIELD_CACHE
+    };
+
+    enum class RawType {
+        UINT8,
+        UINT16,
+        INT16,
+        FLOAT32,
+        FLOAT64
+    };
+
+    // Layout of a headerless volume holding a single scalar field in x-fastest order
+    struct RawVolumeInfo {
+        std::string field_name;
+        int nx = 0, ny = 0, nz = 0;
+        Vector3f spacing = Vector3f(1.0f);
+        Vector3f origin = Vector3f(0.0f);
+        RawType type = RawType::UINT16;
+        bool big_endian = false;
+        size_t header_bytes = 0; // Bytes to skip before the first value
+    };
+
+    // Where the values of one array live in the source file, found by the indexing pass of a load
+    struct FieldExtent {
+        std::string name;
+        size_t comps;
+        std::string type;
+        size_t begin; // Byte range of the values (for a field cache, the column offset)
+        size_t end;
+        bool loaded = false;
+    };
+
     struct VolumeData {
         std::string filename;
         int nx, ny, nz;
         Vector3f origin;
         Vector3f spacing;
-        std::unordered_map<std::string, std::vector<float>> scalars;
+        std::unordered_map<std::string, ScalarField> scalars;
+        // Multi-component arrays, mapping the array name to its per-component entries in scalars
+        std::unordered_map<std::string, std::vector<std::string>> groups;
+        // Value ranges known up front (from a field cache), others are computed on demand
+        std::unordered_map<std::string, std::pair<float, float>> ranges;
         ~VolumeData(); // always declare; debug print guarded in cpp
     };
 
@@ -25,25 +68,67 @@ namespace MVF {
         std::ifstream file;
         std::string filename;
         std::shared_ptr<VolumeData> data;
+        // Progress of the current pass against total_bytes. Despite the name it counts values (bytes while a
+        // text file is indexed), stats has the actual byte and value counts.
         std::atomic<size_t> num_bytes_read;
         std::atomic<bool> stop_requested;
-        size_t total_bytes;
+        std::atomic<bool> load_finished;
+        std::atomic<size_t> total_bytes;
         size_t total_fields_read;
         size_t total_fields;
         size_t field_size;
         std::streampos file_offset;
+        VolumeFormat format;
+        RawVolumeInfo raw_info;
         bool read_failed;
         std::atomic<bool> thread_dispatched;
         std::thread worker_thread;
+        std::thread cache_thread;
+        std::atomic<bool> stop_cache = false; // Raised when the proxy is dropped before its cache is written
+        std::vector<FieldExtent> field_index;
+        std::vector<size_t> pending_fields; // Indices into field_index of the fields being loaded
+        LoadStats stats;
 
+        // Starts the load. Legacy VTK files and field caches are only indexed, their arrays are listed but
+        // stay empty until they are requested through load_fields().
         bool load();
+        // Loads the listed fields (array or component names) in the background, returns false if all of
+        // them are already in memory
+        bool load_fields(const std::vector<std::string>& names);
+        // Allocates the arrays for a field. Arrays with several components are split into one scalar per
+        // component (name_X, name_Y, ...) and registered as a group under the array's name.
+        std::vector<float*> add_field(const std::string& name, size_t comps);
+        // Same as above for a field stored as the given type, the arrays hold values of that type
+        std::vector<void*> add_field(const std::string& name, size_t comps, FieldType type);
+        // Counts values written into the field arrays, for both progress and throughput
+        void report_values(size_t count);
         void cancel_io();
         void complete();
+        // Waits for the field cache written after a full load, dropping the proxy gives it up instead
+        void finish_cache();
         void reset();
         ~LoadProxy(); // always declare; debug print guarded in cpp
+
+    private:
+        void index_ascii();
+        void index_binary();
+        void add_field_index(FieldExtent extent);
+        void finish_field_load();
+        void read_ascii();
+        void read_binary();
+        void read_vti();
+        void read_raw();
+        void read_cache();
+        void write_cache();
     };
 
     bool read_file(const std::string& filename, std::string& out);
     std::unique_ptr<LoadProxy> open_vtk_async(const std::string& filename);
+    std::unique_ptr<LoadProxy> open_vti_async(const std::string& filename);
+    std::unique_ptr<LoadProxy> open_raw_async(const std::string& filename, const RawVolumeInfo& info);
+    // Fills in the field name, dimensions and type from names like beechnut_1024x1024x1546_uint16.raw
+    bool guess_raw_info(const std::string& filename, RawVolumeInfo& info);
+    // Picks the reader from the file extension
+    std::unique_ptr<LoadProxy> open_volume_async(const std::string& filename);
 }
 
@@ -2,6 +2,8 @@
 
 #include <gtkmm.h>
 #include <functional>
+#include <array>
+#include "vtk.h"
 
 class OverlayProgressBar : public Gtk::Box {
 public:
@@ -9,9 +11,15 @@ public:
     void show();
     void hide();
     void set_fraction(double fraction);
+    // Extra text shown next to the percentage (e.g. load throughput), cleared when the bar is hidden
+    void set_detail(const std::string& text);
 private:
     Gtk::ProgressBar progress_bar;
     Gtk::Label label_progress;
+    std::string detail;
+    int percent = 0;
+
+    void update_label();
 };
 
 class HoverOverlay : public Gtk::Popover {
@@ -32,6 +40,8 @@ public:
     void update_list(const std::vector<std::string>& options);
     void set_secondary_handler(std::function<void()> handler);
     void set_active_mask(std::vector<std::string>& labels);
+    // Runs the selection handlers as if the popover had just been closed
+    void emit_selection();
 private:
     Gtk::Button main_button;
     Gtk::Popover popover;
@@ -47,3 +57,22 @@ class Slider : public Gtk::Scale {
 public:
     Slider(std::function<void()> handler);
 };
+
+// Asks for the layout of a headerless volume before it is imported
+class RawImportDialog : public Gtk::Window {
+public:
+    RawImportDialog(Gtk::Window& parent, const MVF::RawVolumeInfo& info, std::function<void(const MVF::RawVolumeInfo&)> on_accept);
+private:
+    Gtk::Box vbox{Gtk::Orientation::VERTICAL, 10};
+    Gtk::Box button_box{Gtk::Orientation::HORIZONTAL, 10};
+    Gtk::Grid grid;
+    Gtk::Entry name_entry;
+    std::array<Gtk::SpinButton, 3> dim_buttons, spacing_buttons, origin_buttons;
+    Gtk::SpinButton header_button;
+    Gtk::ComboBoxText type_menu;
+    Gtk::CheckButton big_endian_check{"Big endian"};
+    Gtk::Button import_button{"Import"}, cancel_button{"Cancel"};
+    std::function<void(const MVF::RawVolumeInfo&)> on_accept;
+
+    void on_import();
+};
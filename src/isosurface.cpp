@@ -0,0 +1,457 @@
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include "isosurface.h"
+#include "marching_cubes.h"
+#include "distance_field.h"
+#include "parallel.h"
+
+// Grid samples handed to a worker at a time, rounded to whole layers
+constexpr size_t ISO_SLAB_SAMPLES = 1 << 16;
+// The first layer after a slab is scanned again by that slab to find the ids of the vertices on it, thinner
+// slabs would scan too many layers twice
+constexpr size_t ISO_SLAB_MIN_LAYERS = 4;
+
+namespace MVF {
+    // Each sample owns the 3 edges leaving it towards +x, +y and +z. A cell edge is found as the edge along
+    // axis owned by the corner of the cell at (dx, dy, dz).
+    struct CellEdge {
+        size_t dx, dy, dz;
+        size_t axis;
+    };
+
+    struct CellTables {
+        std::array<CellEdge, 12> edges;
+        std::array<uint8_t, 256> triangles;
+    };
+
+    // Corners are numbered with x in bit 0, y in bit 1 and z in bit 2, which is how edge_vertex_indices reads
+    static const CellTables& cell_tables() {
+        static const CellTables tables = [] {
+            CellTables tables;
+            for (size_t e = 0; e < 12; e++) {
+                size_t a = edge_vertex_indices[e][0];
+                size_t b = edge_vertex_indices[e][1];
+                size_t owner = a & b;
+                size_t axis = (a ^ b) == 1 ? 0 : (a ^ b) == 2 ? 1 : 2;
+                tables.edges[e] = CellEdge {.dx = owner & 1, .dy = (owner >> 1) & 1, .dz = (owner >> 2) & 1,
+                    .axis = axis};
+            }
+
+            for (size_t c = 0; c < 256; c++) {
+                size_t count = 0;
+                while (count < 5 && tri_table[c][3 * count] != -1) {
+                    count++;
+                }
+                tables.triangles[c] = count;
+            }
+
+            return tables;
+        }();
+
+        return tables;
+    }
+
+    void resample_field(size_t nx, size_t ny, size_t nz, const uint16_t* field, const uint8_t* color_ids,
+        size_t res_x, size_t res_y, size_t res_z, IsoGrid& grid, const std::atomic<bool>* stop) {
+        // Grid point k is at (k + 0.5) / res in texture coordinates and voxel i at (i + 0.5) / n, so a grid of the
+        // field's own size holds it unchanged. Outside the outermost voxel centres the field is clamped.
+        struct Tap {
+            size_t i0, i1;
+            float f;
+            size_t nearest;
+        };
+
+        auto make_taps = [] (size_t n, size_t res) {
+            std::vector<Tap> taps(res);
+            for (size_t k = 0; k < res; k++) {
+                auto u = static_cast<double>((2 * k + 1) * n) / (2 * res) - 0.5;
+                auto u0 = std::floor(u);
+                auto i0 = static_cast<long>(u0);
+                taps[k].i0 = std::clamp<long>(i0, 0, n - 1);
+                taps[k].i1 = std::clamp<long>(i0 + 1, 0, n - 1);
+                taps[k].f = u - u0;
+                taps[k].nearest = std::min((2 * k + 1) * n / (2 * res), n - 1);
+            }
+            return taps;
+        };
+
+        auto taps_x = make_taps(nx, res_x);
+        auto taps_y = make_taps(ny, res_y);
+        auto taps_z = make_taps(nz, res_z);
+
+        grid.nx = res_x;
+        grid.ny = res_y;
+        grid.nz = res_z;
+        grid.values.resize(res_x * res_y * res_z);
+        grid.color_ids.resize(res_x * res_y * res_z);
+
+        parallel_for(res_z, [&] (size_t k) {
+            if (stop && stop->load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            auto& tz = taps_z[k];
+            for (size_t j = 0; j < res_y; j++) {
+                auto& ty = taps_y[j];
+                size_t row00 = (tz.i0 * ny + ty.i0) * nx;
+                size_t row01 = (tz.i0 * ny + ty.i1) * nx;
+                size_t row10 = (tz.i1 * ny + ty.i0) * nx;
+                size_t row11 = (tz.i1 * ny + ty.i1) * nx;
+                size_t out = (k * res_y + j) * res_x;
+                size_t nearest_row = (tz.nearest * ny + ty.nearest) * nx;
+                for (size_t i = 0; i < res_x; i++) {
+                    auto& tx = taps_x[i];
+                    auto lerp_x = [&] (size_t row) {
+                        return field[row + tx.i0] + (static_cast<float>(field[row + tx.i1]) - field[row + tx.i0]) * tx.f;
+                    };
+                    auto v0 = lerp_x(row00) + (lerp_x(row01) - lerp_x(row00)) * ty.f;
+                    auto v1 = lerp_x(row10) + (lerp_x(row11) - lerp_x(row10)) * ty.f;
+                    grid.values[out + i] = static_cast<uint16_t>(std::lround(v0 + (v1 - v0) * tz.f));
+                    grid.color_ids[out + i] = color_ids[nearest_row + tx.nearest];
+                }
+            }
+        });
+    }
+
+    size_t brick_count(size_t n) {
+        return n < 2 ? 0 : (n - 2) / ISO_BRICK_CELLS + 1;
+    }
+
+    void build_bricks(IsoGrid& grid, const std::atomic<bool>* stop) {
+        grid.bricks.clear();
+        if (grid.nx < 2 || grid.ny < 2 || grid.nz < 2) {
+            return;
+        }
+
+        const size_t nx = grid.nx, ny = grid.ny, nz = grid.nz;
+        auto& base = grid.bricks.emplace_back();
+        base.nx = brick_count(nx);
+        base.ny = brick_count(ny);
+        base.nz = brick_count(nz);
+        base.min.resize(base.nx * base.ny * base.nz);
+        base.max.resize(base.min.size());
+
+        parallel_for(base.nz, [&] (size_t bz) {
+            if (stop && stop->load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            size_t k_end = std::min(nz - 1, (bz + 1) * ISO_BRICK_CELLS);
+            for (size_t by = 0; by < base.ny; by++) {
+                size_t j_end = std::min(ny - 1, (by + 1) * ISO_BRICK_CELLS);
+                for (size_t bx = 0; bx < base.nx; bx++) {
+                    size_t i_end = std::min(nx - 1, (bx + 1) * ISO_BRICK_CELLS);
+                    uint16_t lo = UINT16_MAX, hi = 0;
+                    for (size_t k = bz * ISO_BRICK_CELLS; k <= k_end; k++) {
+                        for (size_t j = by * ISO_BRICK_CELLS; j <= j_end; j++) {
+                            const uint16_t* row = grid.values.data() + (k * ny + j) * nx;
+                            for (size_t i = bx * ISO_BRICK_CELLS; i <= i_end; i++) {
+                                lo = std::min(lo, row[i]);
+                                hi = std::max(hi, row[i]);
+                            }
+                        }
+                    }
+                    size_t b = (bz * base.ny + by) * base.nx + bx;
+                    base.min[b] = lo;
+                    base.max[b] = hi;
+                }
+            }
+        });
+
+        while (grid.bricks.back().min.size() > 1) {
+            const auto& below = grid.bricks.back();
+            IsoBrickLevel level;
+            level.nx = (below.nx + 1) / 2;
+            level.ny = (below.ny + 1) / 2;
+            level.nz = (below.nz + 1) / 2;
+            level.min.assign(level.nx * level.ny * level.nz, UINT16_MAX);
+            level.max.assign(level.min.size(), 0);
+            for (size_t z = 0; z < below.nz; z++) {
+                for (size_t y = 0; y < below.ny; y++) {
+                    for (size_t x = 0; x < below.nx; x++) {
+                        size_t child = (z * below.ny + y) * below.nx + x;
+                        size_t node = (z / 2 * level.ny + y / 2) * level.nx + x / 2;
+                        level.min[node] = std::min(level.min[node], below.min[child]);
+                        level.max[node] = std::max(level.max[node], below.max[child]);
+                    }
+                }
+            }
+            grid.bricks.push_back(std::move(level));
+        }
+    }
+
+    void find_active_bricks(const IsoGrid& grid, int32_t threshold, std::vector<uint32_t>& bricks) {
+        bricks.clear();
+        if (grid.bricks.empty()) {
+            size_t count = brick_count(grid.nx) * brick_count(grid.ny) * brick_count(grid.nz);
+            for (size_t b = 0; b < count; b++) {
+                bricks.push_back(b);
+            }
+            return;
+        }
+
+        // Descends from the top into the nodes with samples on both sides of threshold
+        auto straddles = [&] (const IsoBrickLevel& level, size_t node) {
+            return level.min[node] <= threshold && level.max[node] > threshold;
+        };
+        std::vector<size_t> nodes;
+        if (straddles(grid.bricks.back(), 0)) {
+            nodes.push_back(0);
+        }
+        for (size_t l = grid.bricks.size() - 1; l-- > 0 && !nodes.empty();) {
+            const auto& level = grid.bricks[l];
+            const auto& above = grid.bricks[l + 1];
+            std::vector<size_t> children;
+            for (auto node : nodes) {
+                size_t x = node % above.nx, y = node / above.nx % above.ny, z = node / (above.nx * above.ny);
+                for (size_t cz = 2 * z; cz < std::min(2 * z + 2, level.nz); cz++) {
+                    for (size_t cy = 2 * y; cy < std::min(2 * y + 2, level.ny); cy++) {
+                        for (size_t cx = 2 * x; cx < std::min(2 * x + 2, level.nx); cx++) {
+                            size_t child = (cz * level.ny + cy) * level.nx + cx;
+                            if (straddles(level, child)) {
+                                children.push_back(child);
+                            }
+                        }
+                    }
+                }
+            }
+            nodes.swap(children);
+        }
+
+        bricks.assign(nodes.begin(), nodes.end());
+        std::sort(bricks.begin(), bricks.end());
+    }
+
+    // Samples are whole numbers, so the threshold can be too
+    int32_t iso_threshold(float iso_value) {
+        return std::floor(std::clamp(iso_value * DISTANCE_FIELD_ONE, -1.0f, static_cast<float>(DISTANCE_FIELD_ONE)));
+    }
+
+    void extract_isosurface(const IsoGrid& grid, float iso_value, IsoMesh& mesh) {
+        mesh.vertices.clear();
+        mesh.indices.clear();
+        if (grid.nx < 2 || grid.ny < 2 || grid.nz < 2) {
+            return;
+        }
+
+        const auto& tables = cell_tables();
+        const size_t nx = grid.nx, ny = grid.ny, nz = grid.nz;
+        const size_t layer = nx * ny;
+        const size_t strides[3] = {1, nx, layer};
+        const float steps[3] = {grid.step.x, grid.step.y, grid.step.z};
+        const uint16_t* values = grid.values.data();
+
+        // Compared in the units the field is stored in
+        const float iso = iso_value * DISTANCE_FIELD_ONE;
+        const int32_t threshold = iso_threshold(iso_value);
+
+        auto inside = [&] (size_t idx) -> size_t {
+            return values[idx] <= threshold;
+        };
+
+        // Bricks the surface can pass through
+        const size_t bx = brick_count(nx), by = brick_count(ny), bz = brick_count(nz);
+        std::vector<uint32_t> active_bricks;
+        find_active_bricks(grid, threshold, active_bricks);
+        std::vector<uint8_t> active(bx * by * bz, 0);
+        for (auto b : active_bricks) {
+            active[b] = 1;
+        }
+
+        // Calls run(begin, end) for each run of the first count samples or cells of row j of layer k that lies in
+        // active bricks. The sample past the last cell along an axis belongs to the last brick.
+        auto for_each_active_run = [&] (size_t j, size_t k, size_t count, auto&& run) {
+            const uint8_t* row = active.data() +
+                (std::min(k / ISO_BRICK_CELLS, bz - 1) * by + std::min(j / ISO_BRICK_CELLS, by - 1)) * bx;
+            for (size_t b = 0; b < bx; b++) {
+                if (row[b]) {
+                    size_t begin = b * ISO_BRICK_CELLS;
+                    while (b + 1 < bx && row[b + 1]) {
+                        b++;
+                    }
+                    run(begin, b + 1 == bx ? count : (b + 1) * ISO_BRICK_CELLS);
+                }
+            }
+        };
+
+        // Corners of a cell on its face towards -x, in the bits they take in the cell's case
+        auto face_case = [&] (size_t idx) {
+            return inside(idx) | inside(idx + nx) << 2 | inside(idx + layer) << 4 | inside(idx + layer + nx) << 6;
+        };
+
+        // Calls cell(i, j, code) for every cell of layer k in an active brick, the face a cell shares with
+        // the next one along x is only looked at once
+        auto for_each_cell = [&] (size_t k, auto&& cell) {
+            for (size_t j = 0; j + 1 < ny; j++) {
+                for_each_active_run(j, k, nx - 1, [&] (size_t begin, size_t end) {
+                    size_t idx = k * layer + j * nx + begin;
+                    auto face = face_case(idx);
+                    for (size_t i = begin; i < end; i++, idx++) {
+                        auto next_face = face_case(idx + 1);
+                        cell(i, j, face | next_face << 1);
+                        face = next_face;
+                    }
+                });
+            }
+        };
+
+        // Calls edge(idx, i, j, axis) for every edge owned by a sample of layer k that the surface crosses, in the
+        // order vertex ids are handed out in. The edges owned by a sample lie in the brick it belongs to.
+        auto for_each_crossing = [&] (size_t k, auto&& edge) {
+            bool has_above = k + 1 < nz;
+            for (size_t j = 0; j < ny; j++) {
+                for_each_active_run(j, k, nx, [&] (size_t begin, size_t end) {
+                    size_t idx = k * layer + j * nx + begin;
+                    auto next_in = inside(idx);
+                    for (size_t i = begin; i < end; i++, idx++) {
+                        auto in = next_in;
+                        next_in = i + 1 < nx ? inside(idx + 1) : in;
+                        if (next_in != in) {
+                            edge(idx, i, j, 0);
+                        }
+                        if (j + 1 < ny && inside(idx + nx) != in) {
+                            edge(idx, i, j, 1);
+                        }
+                        if (has_above && inside(idx + layer) != in) {
+                            edge(idx, i, j, 2);
+                        }
+                    }
+                });
+            }
+        };
+
+        const size_t slab_layers = std::max(ISO_SLAB_MIN_LAYERS, (ISO_SLAB_SAMPLES + layer - 1) / layer);
+        const size_t slab_count = (nz + slab_layers - 1) / slab_layers;
+
+        // Vertices owned by each layer of samples and triangles in each layer of cells, turned into the offset of
+        // each layer's first one below
+        std::vector<size_t> layer_vertices(nz + 1, 0), layer_triangles(nz + 1, 0);
+        parallel_for(slab_count, [&] (size_t slab) {
+            size_t k_end = std::min(nz, (slab + 1) * slab_layers);
+            for (size_t k = slab * slab_layers; k < k_end; k++) {
+                size_t count = 0;
+                for_each_crossing(k, [&] (size_t, size_t, size_t, size_t) {
+                    count++;
+                });
+                layer_vertices[k] = count;
+
+                if (k + 1 < nz) {
+                    count = 0;
+                    for_each_cell(k, [&] (size_t, size_t, size_t code) {
+                        count += tables.triangles[code];
+                    });
+                    layer_triangles[k] = count;
+                }
+            }
+        });
+
+        size_t vertex_count = 0, triangle_count = 0;
+        for (size_t k = 0; k <= nz; k++) {
+            auto vertices = layer_vertices[k];
+            auto triangles = layer_triangles[k];
+            layer_vertices[k] = vertex_count;
+            layer_triangles[k] = triangle_count;
+            vertex_count += vertices;
+            triangle_count += triangles;
+        }
+
+        if (vertex_count > UINT32_MAX) {
+            throw std::runtime_error("Isosurface has too many vertices for 32 bit indices...");
+        }
+
+        mesh.vertices.resize(vertex_count);
+        mesh.indices.resize(3 * triangle_count);
+
+        // Central differences inside the grid and one sided ones on its faces, in object space
+        auto gradient = [&] (size_t idx, size_t i, size_t j, size_t k, float g[3]) {
+            const size_t coords[3] = {i, j, k};
+            const size_t dims[3] = {nx, ny, nz};
+            for (size_t a = 0; a < 3; a++) {
+                size_t lo = coords[a] > 0 ? idx - strides[a] : idx;
+                size_t hi = coords[a] + 1 < dims[a] ? idx + strides[a] : idx;
+                auto span = ((hi != idx) + (lo != idx)) * steps[a];
+                g[a] = span > 0 ? (static_cast<float>(values[hi]) - values[lo]) / span : 0;
+            }
+        };
+
+        auto emit_vertex = [&] (uint32_t id, size_t idx, size_t i, size_t j, size_t k, size_t axis) {
+            size_t other = idx + strides[axis];
+            float v0 = values[idx], v1 = values[other];
+            float t = (iso - v0) / (v1 - v0);
+
+            float pos[3] = {static_cast<float>(i), static_cast<float>(j), static_cast<float>(k)};
+            pos[axis] += t;
+
+            const size_t other_coords[3] = {i + (axis == 0), j + (axis == 1), k + (axis == 2)};
+            float g0[3], g1[3], n[3];
+            gradient(idx, i, j, k, g0);
+            gradient(other, other_coords[0], other_coords[1], other_coords[2], g1);
+            float len = 0;
+            for (size_t a = 0; a < 3; a++) {
+                n[a] = g0[a] + (g1[a] - g0[a]) * t;
+                len += n[a] * n[a];
+            }
+
+            // Triangles in tri_table face down the field, towards the traits, and so do the normals. Where the
+            // gradient vanishes, the edge itself is the best guess.
+            len = std::sqrt(len);
+            if (len > 0) {
+                for (auto& c : n) {
+                    c /= -len;
+                }
+            }
+            else {
+                n[0] = n[1] = n[2] = 0;
+                n[axis] = v1 > v0 ? -1 : 1;
+            }
+
+            mesh.vertices[id] = IsoVertex {
+                .x = grid.origin.x + pos[0] * steps[0],
+                .y = grid.origin.y + pos[1] * steps[1],
+                .z = grid.origin.z + pos[2] * steps[2],
+                .nx = n[0], .ny = n[1], .nz = n[2],
+                .color_id = grid.color_ids[v0 <= threshold ? idx : other]
+            };
+        };
+
+        parallel_for(slab_count, [&] (size_t slab) {
+            size_t k_begin = slab * slab_layers;
+            size_t k_end = std::min(nz, k_begin + slab_layers);
+
+            // Ids of the vertices on the edges owned by the samples of the current and next layer, 3 per sample
+            std::vector<uint32_t> ids(3 * layer), next_ids(3 * layer);
+
+            // The layer after the slab belongs to the next slab, its ids are worked out the same way here but
+            // its vertices are left to that slab
+            auto scan_layer = [&] (size_t k, std::vector<uint32_t>& layer_ids, bool emit) {
+                auto id = static_cast<uint32_t>(layer_vertices[k]);
+                for_each_crossing(k, [&] (size_t idx, size_t i, size_t j, size_t axis) {
+                    layer_ids[3 * (idx - k * layer) + axis] = id;
+                    if (emit) {
+                        emit_vertex(id, idx, i, j, k, axis);
+                    }
+                    id++;
+                });
+            };
+
+            scan_layer(k_begin, ids, true);
+            for (size_t k = k_begin; k < k_end && k + 1 < nz; k++) {
+                scan_layer(k + 1, next_ids, k + 1 < k_end);
+
+                auto out = mesh.indices.begin() + 3 * layer_triangles[k];
+                for_each_cell(k, [&] (size_t i, size_t j, size_t code) {
+                    for (size_t e = 0; e < 3 * tables.triangles[code]; e++) {
+                        auto& edge = tables.edges[tri_table[code][e]];
+                        auto& layer_ids = edge.dz ? next_ids : ids;
+                        *out++ = layer_ids[3 * ((j + edge.dy) * nx + i + edge.dx) + edge.axis];
+                    }
+                });
+
+                ids.swap(next_ids);
+            }
+        });
+    }
+}
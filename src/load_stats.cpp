@@ -0,0 +1,86 @@
+#include <sstream>
+#include <iomanip>
+#include "load_stats.h"
+
+namespace MVF {
+    void LoadStats::start() {
+        start_time = Clock::now();
+        bytes.store(0, std::memory_order_relaxed);
+        values.store(0, std::memory_order_relaxed);
+        for (auto& time : phase_ns) {
+            time.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void LoadStats::finish_header() {
+        add_time(LoadPhase::HEADER, Clock::now() - start_time);
+    }
+
+    void LoadStats::add_bytes(size_t count) {
+        bytes.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void LoadStats::add_values(size_t count) {
+        values.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void LoadStats::add_time(LoadPhase phase, Clock::duration time) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+        phase_ns[static_cast<size_t>(phase)].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    size_t LoadStats::bytes_read() const {
+        return bytes.load(std::memory_order_relaxed);
+    }
+
+    size_t LoadStats::values_parsed() const {
+        return values.load(std::memory_order_relaxed);
+    }
+
+    double LoadStats::elapsed() const {
+        return std::chrono::duration<double>(Clock::now() - start_time).count();
+    }
+
+    double LoadStats::phase_time(LoadPhase phase) const {
+        return phase_ns[static_cast<size_t>(phase)].load(std::memory_order_relaxed) * 1e-9;
+    }
+
+    double LoadStats::mb_per_sec() const {
+        auto secs = elapsed();
+        return secs > 0 ? bytes_read() / (1024.0 * 1024.0) / secs : 0;
+    }
+
+    double LoadStats::values_per_sec() const {
+        auto secs = elapsed();
+        return secs > 0 ? values_parsed() / secs : 0;
+    }
+
+    double LoadStats::eta(double fraction) const {
+        if (fraction <= 0) {
+            return -1;
+        }
+        return elapsed() * (1 - std::min(fraction, 1.0)) / fraction;
+    }
+
+    std::string LoadStats::progress_text(double fraction) const {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1) << mb_per_sec() << " MB/s, "
+           << values_per_sec() / 1e6 << " M values/s";
+
+        auto left = eta(fraction);
+        if (left >= 0) {
+            ss << ", ETA " << std::setprecision(0) << std::max(left, 1.0) << " s";
+        }
+        return ss.str();
+    }
+
+    std::string LoadStats::summary() const {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(2)
+           << bytes_read() / (1024.0 * 1024.0) << " MB read, " << values_parsed() / 1e6 << " M values parsed in "
+           << elapsed() << " s (" << mb_per_sec() << " MB/s, " << values_per_sec() / 1e6 << " M values/s) | header "
+           << phase_time(LoadPhase::HEADER) << " s, read " << phase_time(LoadPhase::READ) << " s, parse "
+           << phase_time(LoadPhase::PARSE) << " s, finalize " << phase_time(LoadPhase::FINALIZE) << " s";
+        return ss.str();
+    }
+}
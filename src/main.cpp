@@ -2,6 +2,7 @@
 #include <locale>
 #include <gtkmm.h>
 #include "ui.h"
+#include "batch.h"
 
 // Unstable hack to suppress the locale warning
 extern "C" void suppress_locale_warning(const gchar *domain, GLogLevelFlags level, const gchar *message, gpointer user_data) {
@@ -11,6 +12,11 @@ extern "C" void suppress_locale_warning(const gchar *domain, GLogLevelFlags leve
 
 int main(int argc, char* argv[])
 {
+    // Batch runs never touch GTK, so they work without a display
+    if (argc > 1 && std::string_view(argv[1]) == "--batch") {
+        return MVF::run_batch(argc, argv);
+    }
+
     g_log_set_default_handler(suppress_locale_warning, nullptr);
 
     auto app = Gtk::Application::create("mvf.app");
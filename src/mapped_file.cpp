@@ -0,0 +1,160 @@
+#include <iostream>
+#include <utility>
+#include <atomic>
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace MVF {
+    MappedFile::MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            base = std::exchange(other.base, nullptr);
+            length = std::exchange(other.length, 0);
+#ifdef _WIN32
+            file_handle = std::exchange(other.file_handle, nullptr);
+            map_handle = std::exchange(other.map_handle, nullptr);
+#endif
+        }
+
+        return *this;
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::open(const std::string& filename) {
+        close();
+
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            std::cerr << "Unable to open file: " << filename << std::endl;
+            return false;
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return false;
+        }
+
+        auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        file_handle = file;
+        map_handle = mapping;
+        base = static_cast<const char*>(view);
+        length = static_cast<size_t>(file_size.QuadPart);
+
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (base) {
+            UnmapViewOfFile(base);
+        }
+        if (map_handle) {
+            CloseHandle(map_handle);
+        }
+        if (file_handle) {
+            CloseHandle(file_handle);
+        }
+
+        base = nullptr;
+        length = 0;
+        file_handle = map_handle = nullptr;
+    }
+#else
+    bool MappedFile::open(const std::string& filename) {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Unable to open file: " << filename << std::endl;
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping keeps its own reference to the file
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            std::cerr << "Unable to map file: " << filename << std::endl;
+            return false;
+        }
+
+        // Fields are consumed front to back, let the kernel read ahead aggressively
+        madvise(view, st.st_size, MADV_SEQUENTIAL);
+
+        base = static_cast<const char*>(view);
+        length = static_cast<size_t>(st.st_size);
+
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (base) {
+            munmap(const_cast<char*>(base), length);
+        }
+
+        base = nullptr;
+        length = 0;
+    }
+#endif
+
+    bool MappedFile::is_open() const {
+        return base != nullptr;
+    }
+
+    const char* MappedFile::data() const {
+        return base;
+    }
+
+    size_t MappedFile::size() const {
+        return length;
+    }
+
+    // Keeps the loads in prefault() from being optimised away
+    static std::atomic<unsigned char> prefault_sink;
+
+    void prefault(const char* ptr, size_t size) {
+        constexpr size_t page_size = 4096;
+        unsigned char sum = 0;
+        for (size_t i = 0; i < size; i += page_size) {
+            sum += static_cast<unsigned char>(ptr[i]);
+        }
+        if (size) {
+            sum += static_cast<unsigned char>(ptr[size - 1]);
+        }
+        prefault_sink.store(sum, std::memory_order_relaxed);
+    }
+}
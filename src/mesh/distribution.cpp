@@ -22,12 +22,15 @@ namespace MVF {
         size_t max_val = 0;
         bins.resize(samples);
 
-        for (size_t x_idx = 0; x_idx < field1.size(); x_idx += sample_period) {
-            auto bin_idx = get_bin_idx(field1[x_idx]);  
-            bins[bin_idx]++;
-        
-            max_val = std::max(bins[bin_idx], max_val);
-        }
+        auto num_values = field1.size();
+        field1.visit([&] (auto* values) {
+            for (size_t x_idx = 0; x_idx < num_values; x_idx += sample_period) {
+                auto bin_idx = get_bin_idx(static_cast<float>(values[x_idx]));
+                bins[bin_idx]++;
+
+                max_val = std::max(bins[bin_idx], max_val);
+            }
+        });
 
         // Generate the mesh
         auto bin_width = AXIS_LENGTH / samples;
@@ -95,6 +95,21 @@ namespace MVF {
         create_buffers();
     }
 
+    void VolumeEntity::set_vector_mode(const std::string& group) {
+        auto it = model->groups.find(group);
+        if (it == model->groups.end() || it->second.size() < 2) {
+            throw std::runtime_error("set_vector_mode() called with invalid group " + group);
+        }
+
+        auto& comps = it->second;
+        if (comps.size() == 2) {
+            set_vector_mode(comps[0], comps[1]);
+        }
+        else {
+            set_vector_mode(comps[0], comps[1], comps[2]);
+        }
+    }
+
     void VolumeEntity::set_scalar_slice(const std::string& field, int axis) {
         type.mode = EntityMode::SCALAR_SLICE;
         type.data = ScalarSliceDesc{field, axis};
@@ -235,10 +250,13 @@ namespace MVF {
             glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE); 
           
             auto& field = model->scalars[std::get<ScalarSliceDesc>(type.data).field];
-            auto [_, max_val] = std::minmax_element(field.begin(), field.end());
-            std::vector<float> normalized = field | std::views::transform([max_val] (float val) {
-                return val / *max_val;
-            }) | std::ranges::to<std::vector>();
+            auto [_, max_val] = field.minmax();
+            std::vector<float> normalized(field.size());
+            field.visit([&normalized, max_val] (auto* values) {
+                for (size_t i = 0; i < normalized.size(); i++) {
+                    normalized[i] = static_cast<float>(values[i]) / max_val;
+                }
+            });
 
             glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, model->nx, model->ny, model->nz, 0, GL_RED, GL_FLOAT,   
                 normalized.data()
@@ -374,10 +392,11 @@ namespace MVF {
         auto& vec = it->second; 
         int nx=model->nx, ny=model->ny, nz=model->nz; dvr_buffer.nx=nx; dvr_buffer.ny=ny; dvr_buffer.nz=nz;
         std::vector<uint8_t> vol(nx*ny*nz);
-        float minv=std::numeric_limits<float>::max(), maxv=-std::numeric_limits<float>::max();
-        for(size_t i=0;i<vec.size(); ++i){ float v=vec[i]; minv=std::min(minv,v); maxv=std::max(maxv,v); }
+        auto [minv, maxv] = vec.minmax();
         float denom=(maxv-minv)>0?(maxv-minv):1.f;
-        for(int z=0; z<nz; ++z){ for(int y=0; y<ny; ++y){ for(int x=0; x<nx; ++x){ int idx=(z*ny + y)*nx + x; float sample; sample=vec[idx]; vol[idx]=(uint8_t)(255.f*(sample-minv)/denom); } } }
+        vec.visit([&, minv=minv] (auto* values) {
+            for(size_t idx=0; idx<vol.size(); ++idx){ float sample=static_cast<float>(values[idx]); vol[idx]=(uint8_t)(255.f*(sample-minv)/denom); }
+        });
         glBindTexture(GL_TEXTURE_3D,dvr_buffer.tex3d);
         glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
         glTexParameteri(GL_TEXTURE_3D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
@@ -134,50 +134,52 @@ namespace MVF {
     }
 
     GlyphMesh::GlyphMesh(VolumeData* model, const std::string& field1, const std::string& field2, const std::string& field3) {
-        size_t sample_point = 0;
-        float max_wgt = 0;
+        size_t field_size = static_cast<size_t>(model->nx) * model->ny * model->nz;
+
+        // Components are looked up once, one that is missing or not loaded yet leaves its direction at 0
+        const std::string* names[3] = {&field1, &field2, &field3};
+        const ScalarField* fields[3] = {};
+        for (int c = 0; c < 3; c++) {
+            auto it = model->scalars.find(*names[c]);
+            if (!names[c]->empty() && it != model->scalars.end() && it->second.size() == field_size) {
+                fields[c] = &it->second;
+            }
+        }
 
-        auto wgt_fn = [] (float u, float v, float w) {
-            return u*u + v*v + w*w;
-        };
+        // Every GLYPH_SAMPLING-th voxel in x-fastest order gets a glyph
+        size_t slice_size = static_cast<size_t>(model->nx) * model->ny;
+        for (size_t idx = 0; idx < field_size; idx += GLYPH_SAMPLING) {
+            auto x = model->origin.x + (idx % model->nx) * model->spacing.x;
+            auto y = model->origin.y + (idx / model->nx % model->ny) * model->spacing.y;
+            auto z = model->origin.z + (idx / slice_size) * model->spacing.z;
+            points.push_back(GlyphInstance{Vector3f(x, y, z), Vector3f(0.0f), 0.0f});
+        }
 
-        for (int i = 0; i < model->nz; i++) {
-            auto z = model->origin.z + i * model->spacing.z;
-            for (int j = 0; j < model->ny; j++) {
-                auto y = model->origin.y + j * model->spacing.y;
-                for (int k = 0; k < model->nx; k++) {
-                    if (sample_point % GLYPH_SAMPLING != 0) {
-                        sample_point += 1;
-                        continue;
-                    }
-                    auto x = model->origin.x + k * model->spacing.x;
-                    auto u_pt = model->scalars[field1][i * model->ny * model->nx + j * model->nx + k];  
-                    auto v_pt = model->scalars[field2][i * model->ny * model->nx + j * model->nx + k];  
-                    auto w_pt = field3.empty() ? 0 : model->scalars[field3][i * model->ny * model->nx + j * model->nx + k];  
-                    points.push_back(GlyphInstance{Vector3f(x, y, z), Vector3f(u_pt, v_pt, w_pt)});
-
-                    max_wgt = std::max(max_wgt, wgt_fn(u_pt, v_pt, w_pt));
-                    sample_point += 1;
-                }
+        // Each component is gathered by a loop compiled for its storage type
+        float Vector3f::* axes[3] = {&Vector3f::x, &Vector3f::y, &Vector3f::z};
+        for (int c = 0; c < 3; c++) {
+            if (!fields[c]) {
+                continue;
             }
+            fields[c]->visit([&] (auto* values) {
+                for (size_t pt = 0; pt < points.size(); pt++) {
+                    points[pt].direction.*axes[c] = static_cast<float>(values[pt * GLYPH_SAMPLING]);
+                }
+            });
         }
-       
+
+        auto wgt_fn = [] (const Vector3f& dir) {
+            return dir.x*dir.x + dir.y*dir.y + dir.z*dir.z;
+        };
+
+        float max_wgt = 0;
+        for (auto& point : points) {
+            max_wgt = std::max(max_wgt, wgt_fn(point.direction));
+        }
+
         // Second pass, apply the scale
-        size_t pt = 0;
-        sample_point = 0;
-        for (int i = 0; i < model->nz; i++) {
-            for (int j = 0; j < model->ny; j++) {
-                for (int k = 0; k < model->nx; k++) {
-                    if (sample_point % GLYPH_SAMPLING != 0) {
-                        sample_point += 1;
-                        continue;
-                    }
-                    points[pt].scale = wgt_fn(points[pt].direction.x, points[pt].direction.y, points[pt].direction.z) / max_wgt;
-
-                    sample_point += 1;
-                    pt++;
-                }
-            }
+        for (auto& point : points) {
+            point.scale = max_wgt > 0 ? wgt_fn(point.direction) / max_wgt : 0.0f;
         }
     }
     
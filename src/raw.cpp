@@ -0,0 +1,228 @@
+#include <iostream>
+#include <filesystem>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <bit>
+#include "vtk.h"
+#include "mapped_file.h"
+#include "parallel.h"
+
+// Number of values converted between progress updates/cancellation checks
+constexpr size_t RAW_CHUNK_VALUES = 1 << 20;
+
+namespace MVF {
+    template <typename T, typename D, bool swap>
+    static void convert_raw(const char* src, void* dest, size_t count) {
+        auto out = static_cast<D*>(dest);
+        if constexpr (sizeof(T) == 1) {
+            std::memcpy(out, src, count);
+        }
+        else {
+            using Bits = std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+            for (size_t i = 0; i < count; i++) {
+                Bits bits;
+                std::memcpy(&bits, src + i * sizeof(T), sizeof(T));
+                if constexpr (swap) {
+                    bits = std::byteswap(bits);
+                }
+                out[i] = static_cast<D>(std::bit_cast<T>(bits));
+            }
+        }
+    }
+
+    using RawConverter = void (*)(const char*, void*, size_t);
+
+    template <typename T, typename D>
+    static RawConverter get_raw_converter(bool big_endian) {
+        constexpr bool native_big = std::endian::native == std::endian::big;
+        return big_endian == native_big ? convert_raw<T, D, false> : convert_raw<T, D, true>;
+    }
+
+    // Returns the element size of a raw value type along with its converter and the type the field is stored as
+    static size_t get_raw_converter(RawType type, bool big_endian, RawConverter& convert, FieldType& storage) {
+        switch (type) {
+            case RawType::UINT8:
+                convert = get_raw_converter<uint8_t, uint8_t>(big_endian);
+                storage = FieldType::UINT8;
+                return 1;
+            case RawType::UINT16:
+                convert = get_raw_converter<uint16_t, uint16_t>(big_endian);
+                storage = FieldType::UINT16;
+                return 2;
+            case RawType::INT16:
+                convert = get_raw_converter<int16_t, int16_t>(big_endian);
+                storage = FieldType::INT16;
+                return 2;
+            case RawType::FLOAT32:
+                convert = get_raw_converter<float, float>(big_endian);
+                storage = FieldType::FLOAT32;
+                return 4;
+            case RawType::FLOAT64:
+                convert = get_raw_converter<double, float>(big_endian);
+                storage = FieldType::FLOAT32;
+                return 8;
+        }
+
+        return 0;
+    }
+
+    bool guess_raw_info(const std::string& filename, RawVolumeInfo& info) {
+        static const std::unordered_map<std::string, RawType> type_names = {
+            {"uint8", RawType::UINT8}, {"u8", RawType::UINT8},
+            {"uint16", RawType::UINT16}, {"u16", RawType::UINT16},
+            {"int16", RawType::INT16}, {"i16", RawType::INT16},
+            {"float32", RawType::FLOAT32}, {"float", RawType::FLOAT32}, {"f32", RawType::FLOAT32},
+            {"float64", RawType::FLOAT64}, {"double", RawType::FLOAT64}, {"f64", RawType::FLOAT64}
+        };
+
+        auto stem = std::filesystem::path(filename).stem().string();
+        bool has_dims = false, has_type = false;
+        std::string name;
+
+        size_t start = 0;
+        while (start <= stem.size()) {
+            auto end = stem.find('_', start);
+            if (end == std::string::npos) {
+                end = stem.size();
+            }
+            std::string token = stem.substr(start, end - start);
+            start = end + 1;
+
+            int dims[3];
+            const char* ptr = token.data();
+            const char* token_end = ptr + token.size();
+            bool is_dims = !token.empty();
+            for (int i = 0; i < 3 && is_dims; i++) {
+                auto [next, ec] = std::from_chars(ptr, token_end, dims[i]);
+                is_dims = ec == std::errc() && dims[i] > 0 && (i == 2 ? next == token_end : next < token_end && *next == 'x');
+                ptr = next + 1;
+            }
+
+            if (is_dims) {
+                info.nx = dims[0];
+                info.ny = dims[1];
+                info.nz = dims[2];
+                has_dims = true;
+            }
+            else if (auto it = type_names.find(token); it != type_names.end()) {
+                info.type = it->second;
+                has_type = true;
+            }
+            else if (!has_dims) {
+                name += name.empty() ? token : "_" + token;
+            }
+        }
+
+        info.field_name = name.empty() ? "scalars" : name;
+        return has_dims && has_type;
+    }
+
+    std::unique_ptr<LoadProxy> open_raw_async(const std::string& filename, const RawVolumeInfo& info) {
+        auto proxy = std::make_unique<LoadProxy>();
+        proxy->read_failed = true;
+
+        if (info.nx <= 0 || info.ny <= 0 || info.nz <= 0 || info.field_name.empty()) {
+            std::cerr << "Invalid raw volume layout for " << filename << std::endl;
+            return proxy;
+        }
+
+        RawConverter convert = nullptr;
+        FieldType storage;
+        size_t type_size = get_raw_converter(info.type, info.big_endian, convert, storage);
+        size_t field_size = static_cast<size_t>(info.nx) * info.ny * info.nz;
+
+        std::error_code ec;
+        auto file_size = std::filesystem::file_size(filename, ec);
+        if (ec) {
+            std::cerr << "Failed to open " << filename << std::endl;
+            return proxy;
+        }
+
+        if (file_size < info.header_bytes || file_size - info.header_bytes < field_size * type_size) {
+            std::cerr << "Raw volume " << filename << " is smaller than " << info.nx << " x " << info.ny << " x "
+                << info.nz << " values" << std::endl;
+            return proxy;
+        }
+
+        auto vol = std::make_shared<VolumeData>();
+        vol->filename = filename;
+        vol->nx = info.nx;
+        vol->ny = info.ny;
+        vol->nz = info.nz;
+        vol->origin = info.origin;
+        vol->spacing = info.spacing;
+
+        proxy->filename = filename;
+        proxy->data = vol;
+        proxy->format = VolumeFormat::RAW;
+        proxy->raw_info = info;
+        proxy->field_size = field_size;
+        proxy->num_bytes_read = 0;
+        proxy->total_bytes = field_size;
+        proxy->total_fields_read = 0;
+        proxy->total_fields = 1;
+        proxy->file_offset = 0;
+        proxy->read_failed = false;
+        proxy->thread_dispatched = false;
+        proxy->stop_requested = false;
+        proxy->load_finished = false;
+        proxy->stats.finish_header();
+
+        return proxy;
+    }
+
+    void LoadProxy::read_raw() {
+        try {
+            MappedFile mapping;
+            if (!mapping.open(filename)) {
+                read_failed = true;
+                return;
+            }
+
+            RawConverter convert = nullptr;
+            FieldType storage;
+            size_t type_size = get_raw_converter(raw_info.type, raw_info.big_endian, convert, storage);
+            if (mapping.size() < raw_info.header_bytes || mapping.size() - raw_info.header_bytes < field_size * type_size) {
+                std::cerr << "Raw volume " << filename << " is truncated" << std::endl;
+                read_failed = true;
+                return;
+            }
+
+            // The values are converted straight out of the mapping, so the file is never copied. Integer
+            // volumes keep their type, so this is a plain copy for little-endian data.
+            const char* src = mapping.data() + raw_info.header_bytes;
+            auto dest = static_cast<char*>(add_field(raw_info.field_name, 1, storage)[0]);
+            auto elem_size = get_field_type_size(storage);
+            size_t num_chunks = (field_size + RAW_CHUNK_VALUES - 1) / RAW_CHUNK_VALUES;
+            parallel_for(num_chunks, [&] (size_t i) {
+                if (stop_requested.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                size_t first = i * RAW_CHUNK_VALUES;
+                size_t count = std::min(RAW_CHUNK_VALUES, field_size - first);
+                {
+                    PhaseTimer timer(stats, LoadPhase::READ);
+                    prefault(src + first * type_size, count * type_size);
+                    stats.add_bytes(count * type_size);
+                }
+
+                PhaseTimer timer(stats, LoadPhase::PARSE);
+                convert(src + first * type_size, dest + first * elem_size, count);
+                report_values(count);
+            });
+
+            if (stop_requested.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            PhaseTimer timer(stats, LoadPhase::FINALIZE);
+            total_fields_read++;
+            // Unlike the other formats no cache is written, converting a raw file costs as much as reading one
+            load_finished.store(true, std::memory_order_release);
+        } catch (const std::exception& e) {
+            std::cerr << "Error while loading raw volume: " << e.what() << std::endl;
+            read_failed = true;
+        }
+    }
+}
@@ -294,12 +294,18 @@ namespace MVF {
             auto it = data->scalars.find(val.comp_name);
             if (it == data->scalars.end()) continue;
             auto& comp = it->second;
-            auto [mn, mx] = std::minmax_element(comp.begin(), comp.end());
+            float min_val, max_val;
+            if (auto range = data->ranges.find(val.comp_name); range != data->ranges.end()) {
+                std::tie(min_val, max_val) = range->second;
+            }
+            else {
+                std::tie(min_val, max_val) = comp.minmax();
+            }
         #ifdef MVF_DEBUG
-            std::cout << std::format("Field-{}: min_val={:.2f}, max_val={:.2f}", val.comp_name, *mn, *mx) << std::endl;
+            std::cout << std::format("Field-{}: min_val={:.2f}, max_val={:.2f}", val.comp_name, min_val, max_val) << std::endl;
         #endif 
           
-            descriptors.push_back(AxisDescMeta{.desc = val, .min_val = *mn, .max_val = *mx});
+            descriptors.push_back(AxisDescMeta{.desc = val, .min_val = min_val, .max_val = max_val});
         }
         if (descriptors.size() == 1) generate_freq_distribution();
         else if (descriptors.size() == 2) generate_scatter_plot();
@@ -3,42 +3,39 @@
 #include "entity.h"
 #include "marching_cubes.h"
 #include "attrib.h"
+#include "distance_field.h"
+#include "isosurface.h"
 #include "ui_async.h"
 
+// Isosurfaces kept on the GPU, enough for the isovalue slider to be dragged back and forth over a stretch
+constexpr size_t ISO_SURFACE_CACHE = 8;
+// Values per work group of the scan shaders, the classify and emit shaders take a brick of cells each
+constexpr size_t ISO_SCAN_BLOCK = 1024;
+// Work groups GL guarantees along each dimension of a dispatch
+constexpr size_t ISO_MAX_GROUPS = 65535;
+// Grids of more samples are shown up to 2 levels coarser first and refined in the background
+constexpr size_t ISO_SYNC_SAMPLES = 1 << 21;
+constexpr size_t ISO_COARSE_LEVELS = 2;
+// With LOD, the pixels a cell covers on screen at least and the triangles a surface is held to
+constexpr float ISO_LOD_CELL_PIXELS = 2;
+constexpr size_t ISO_TRIANGLE_BUDGET = 2000000;
+
 namespace MVF {
-    FieldEntity::FieldEntity() : Entity::Entity(Vector3f(0, 0, 0)) {
-        create_voxel_grid();
+    FieldEntity::FieldEntity() : Entity::Entity(Vector3f(0, 0, 0)) {}
+
+    FieldEntity::~FieldEntity() {
+        stop_refinement();
     }
 
     void FieldEntity::init(VolumeEntity* geometry_entity) {
         this->geometry_entity = geometry_entity; 
         create_buffers();
         if (traits.size()) {
-            build_texture();
+            build_grid();
         }
     }
 
     void FieldEntity::create_buffers() {
-        // Create the 3d textures
-        glGenTextures(1, &tex3d);
-        glGenTextures(1, &tex3d_col);
-        glBindTexture(GL_TEXTURE_3D, tex3d);
-
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        
-        glBindTexture(GL_TEXTURE_3D, tex3d_col);
-
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    
-        size_t grid_size = res_x * res_y * res_z; 
         GLuint ssbo;
         glGenBuffers(1, &ssbo);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
@@ -50,161 +47,82 @@ namespace MVF {
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_edge);
         glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(edge_table), edge_table, GL_STATIC_DRAW);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ssbo_edge); 
-       
-        // Create the buffers for isosurface extraction
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, grid_size * sizeof(Vertex), points.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
 
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        // Integer textures are only complete without filtering
+        glGenTextures(1, &grid_tex);
+        glGenTextures(1, &grid_col_tex);
+        for (auto tex : {grid_tex, grid_col_tex}) {
+            glBindTexture(GL_TEXTURE_3D, tex);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+        glGenBuffers(1, &brick_buffer);
 
 #ifdef MVF_DEBUG
         std::cout << "Created field buffers..." << std::endl;
 #endif
     }
 
-    void FieldEntity::create_voxel_grid() {
-        auto x_step = 1.0f / res_x; 
-        auto y_step = 1.0f / res_y; 
-        auto z_step = 1.0f / res_z; 
+    void FieldEntity::create_surface_buffers(SurfaceBuffers& surface) {
+        glGenVertexArrays(1, &surface.vao);
+        glBindVertexArray(surface.vao);
 
-        steps = Vector3f(x_step, y_step, z_step);
+        glGenBuffers(1, &surface.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, surface.vbo);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(IsoVertex), (void*)offsetof(IsoVertex, x));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(IsoVertex), (void*)offsetof(IsoVertex, nx));
+        glEnableVertexAttribArray(2);
+        glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(IsoVertex), (void*)offsetof(IsoVertex, color_id));
 
-        size_t grid_size = res_x * res_y * res_z; 
-        points.resize(grid_size);
-        for (size_t i = 0; i < res_z; i++) {
-            for (size_t j = 0; j < res_y; j++) {
-                for (size_t k = 0; k < res_x; k++) {
-                    auto x = k * x_step;
-                    auto y = j * y_step;
-                    auto z = i * z_step;
-                    points[i * res_y * res_x + j * res_x + k] = Vertex {.x = x, .y = y, .z = z};
-                }
-            }
-        }    
+        glGenBuffers(1, &surface.ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, surface.ebo);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glGenBuffers(1, &surface.indirect);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, surface.indirect);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
     }
 
-    void FieldEntity::build_distance_field() {
-        auto grid_size = geometry_entity->model->nx * geometry_entity->model->ny * geometry_entity->model->nz;
-        field.resize(grid_size);
-        color_field.resize(grid_size);
-        
-        float max_dist = 0;
-        for (int i = 0; i < grid_size; i++) {
-            float min_dist = INFINITY;
-            if (stop_requested.load(std::memory_order_relaxed)) {
-                compute_passed = false;
-                return;
-            }
-           
-            advance_ui_clock(static_cast<float>(i) / grid_size, false);
-            // Get the point in attribute space for this point in domain
-            std::vector<float> pt(attrib_comps.size());
-            for (size_t dim = 0; dim < attrib_comps.size(); dim++) {
-                auto& fld = geometry_entity->model->scalars[attrib_comps[dim].desc.comp_name];
-                pt[dim] = fld[i];
-            }
+    // Spreads work groups over y once there are more than a dispatch takes along x, shaders flatten them again
+    static void dispatch_groups(size_t groups) {
+        size_t x = std::min(groups, ISO_MAX_GROUPS);
+        glDispatchCompute(x, (groups + x - 1) / x, 1);
+    }
 
-            // Calculate the min distance of the traits to this point (naive)
-            Trait* sel_trait = nullptr;
-            for (auto& trait: traits) {
-                float dist = INFINITY;
-                switch(trait.type) {
-                    case TraitType::POINT: {
-                        auto& tr_pt = std::get<Point>(trait.data);
-                        if (attrib_comps.size() == 1) {
-                            dist = (tr_pt.x - pt[0]) * (tr_pt.x - pt[0]);
-                        } 
-                        else if (attrib_comps.size() >= 2) {
-                            dist = (tr_pt.y - pt[1]) * (tr_pt.y - pt[1]) + (tr_pt.x - pt[0]) * (tr_pt.x - pt[0]);
-                        } 
-                        break;
-                    }
-                    case TraitType::PARALLEL_POINT: {
-                        auto& nd = std::get<NDPoint>(trait.data);
-                        float dsum = 0.0f;
-                        size_t m = std::min(nd.ys.size(), pt.size());
-                        for (size_t a = 0; a < m; ++a) {
-                            float d = nd.ys[a] - pt[a];
-                            dsum += d * d;
-                        }
-                        dist = dsum;
-                        break;
-                    }
-                    case TraitType::RANGE: {
-                        auto& r = std::get<Range>(trait.data);
-                        if (r.type == RangeType::INTERVAL) {
-                            auto& tr_int = std::get<Interval>(r.range);
-                            if (pt[0] >= tr_int.left && pt[0] <= tr_int.right) {
-                                dist = 0;
-                            }
-                            else {
-                                float d = std::min(std::abs(tr_int.left - pt[0]), std::abs(tr_int.right - pt[0]));
-                                dist = d * d;
-                            }
-                        }
-                        else if (r.type == RangeType::POLYGON) {
-                            auto& tr_poly = std::get<Polygon>(r.range);
-                            if (pt[0] >= tr_poly.x_top && pt[0] <= tr_poly.x_top + tr_poly.width 
-                            && pt[1] >= tr_poly.y_top && pt[1] <= tr_poly.y_top + tr_poly.height) {
-                                dist = 0;
-                            }
-                            else {
-                                float mid_pt_x = tr_poly.x_top + tr_poly.width / 2;   
-                                float mid_pt_y = tr_poly.y_top + tr_poly.height / 2;   
-                                dist = (mid_pt_y - pt[1]) * (mid_pt_y - pt[1]) + (mid_pt_x - pt[0]) * (mid_pt_x - pt[0]);
-                            }
-                        } else if (r.type == RangeType::HYPERBOX) {
-                            auto& hb = std::get<HyperBox>(r.range);
-                            float dsum = 0.0f;
-                            size_t m = std::min(hb.yranges.size(), pt.size());
-                            for (size_t a = 0; a < m; a++) {
-                                float a0 = hb.yranges[a].first;
-                                float a1 = hb.yranges[a].second;
-                                if (a0 > a1) 
-                                    std::swap(a0, a1);
-                                if (pt[a] < a0) { 
-                                    float d = a0 - pt[a];
-                                    dsum += d * d;
-                                }
-                                else if (pt[a] > a1) { 
-                                    float d = pt[a] - a1; 
-                                    dsum += d * d; 
-                                }
-                                else { /* inside -> zero */ }
-                            }
-                            dist = dsum;
-                        }
-                    }
-                }
-               
-                if (dist < min_dist) {
-                    min_dist = dist;
-                    sel_trait = &trait; 
-                }
-            }
+    // Grid point k sits at the centre of the k-th of nx equal cells of the bounding box, whatever the resolution
+    // of the field sampled, so previews at a fraction of the resolution can be sampled in place of the full field
+    static void place_grid(const VolumeData& model, IsoGrid& grid) {
+        grid.step = Vector3f(model.spacing.x * model.nx / grid.nx, model.spacing.y * model.ny / grid.ny,
+            model.spacing.z * model.nz / grid.nz);
+        grid.origin = model.origin + grid.step * 0.5f;
+    }
+
+    void FieldEntity::build_distance_field(DistanceOptions options) {
+        // Previews are handed over to the UI thread, which uploads them on its next tick
+        options.preview = [this] (DistancePreview&& preview) {
+            std::lock_guard<std::mutex> lock(preview_lock);
+            pending_preview = std::move(preview);
+        };
 
-            max_dist = std::max(min_dist, max_dist);
-            field[i] = min_dist;
-            color_field[i] = global_color_pallete[sel_trait->color_id];
+        compute_passed = compute_distance_field(geometry_entity->model, attrib_comps, traits, field, color_ids,
+            dist_state, options, dist_report, stop_requested, [] (float fraction) { advance_ui_clock(fraction, false); });
+        if (!compute_passed) {
+            return;
         }
 
-        // Normalize the field
-        field = field |
-            std::views::transform([max_dist](auto& pt) {
-            return pt / max_dist;
-                }) | std::ranges::to<std::vector<float>>();
+        std::cout << "Distance field " << dist_report.summary() << std::endl;
 
 #ifdef MVF_DEBUG
         size_t zero_count = 0;
         for (auto& val : field) {
-            if (val >= 0 && val <= 0.05) {
+            if (val <= 0.05f * DISTANCE_FIELD_ONE) {
                 zero_count++;
             }
         }
@@ -212,18 +130,399 @@ namespace MVF {
         std::cout << "Zero count: " << zero_count << std::endl;
 #endif
 
+        // The finished field becomes the level 0 grid as it is, no grid is sampled from the old one meanwhile
+        auto& model = *geometry_entity->model;
+        auto native = std::make_shared<IsoGrid>();
+        native->nx = model.nx;
+        native->ny = model.ny;
+        native->nz = model.nz;
+        native->values = std::move(field);
+        native->color_ids = std::move(color_ids);
+        place_grid(model, *native);
+        build_bricks(*native);
+        native_grid = std::move(native);
+
         set_draw_mode = true;
     }
 
-    void FieldEntity::build_texture() {
-        glBindTexture(GL_TEXTURE_3D, tex3d);
-        glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, geometry_entity->model->nx, geometry_entity->model->ny,
-            geometry_entity->model->nz, 0, GL_RED, GL_FLOAT, field.data()
-        );
-    
-        glBindTexture(GL_TEXTURE_3D, tex3d_col);
-        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB32F, geometry_entity->model->nx, geometry_entity->model->ny, 
-            geometry_entity->model->nz, 0, GL_RGB, GL_FLOAT, color_field.data()); 
+    // Samples along an axis of n voxels at a level, each level halves them down to 2
+    static size_t level_resolution(size_t n, size_t level) {
+        return std::max(std::min<size_t>(n, 2), (n + (size_t(1) << level) - 1) >> level);
+    }
+
+    static size_t level_samples(const VolumeData& model, size_t level) {
+        return level_resolution(model.nx, level) * level_resolution(model.ny, level) * level_resolution(model.nz, level);
+    }
+
+    static size_t coarsest_level(const VolumeData& model) {
+        size_t level = 0;
+        while (level_resolution(std::max({model.nx, model.ny, model.nz}), level) > 2) {
+            level++;
+        }
+        return level;
+    }
+
+    static void sample_grid(const VolumeData& model, size_t nx, size_t ny, size_t nz, const uint16_t* field_data,
+        const uint8_t* color_data, size_t res_x, size_t res_y, size_t res_z, IsoGrid& grid,
+        const std::atomic<bool>* stop = nullptr) {
+        resample_field(nx, ny, nz, field_data, color_data, res_x, res_y, res_z, grid, stop);
+        place_grid(model, grid);
+        build_bricks(grid, stop);
+    }
+
+    // Level 0 is the native grid itself, the others are sampled from it
+    static std::shared_ptr<const IsoGrid> sample_level(const VolumeData& model,
+        const std::shared_ptr<const IsoGrid>& native, size_t level, const std::atomic<bool>* stop = nullptr) {
+        if (level == 0) {
+            return native;
+        }
+
+        auto grid = std::make_shared<IsoGrid>();
+        sample_grid(model, native->nx, native->ny, native->nz, native->values.data(), native->color_ids.data(),
+            level_resolution(model.nx, level), level_resolution(model.ny, level), level_resolution(model.nz, level),
+            *grid, stop);
+        return grid;
+    }
+
+    void FieldEntity::set_grid(std::shared_ptr<const IsoGrid> new_grid) {
+        grid = std::move(new_grid);
+        grid_version++;
+    }
+
+    void FieldEntity::build_grid() {
+        stop_refinement();
+        field_grid = false;
+        regrid(0);
+    }
+
+    // Samples the field at level, after showing a coarser level first when that one is slow to sample. Finer
+    // levels than the one on show are sampled on grid_thread and picked up by update_grid.
+    void FieldEntity::regrid(size_t level) {
+        stop_refinement();
+        target_level = level;
+
+        auto model = geometry_entity->model;
+        // Level 0 costs nothing to show, so it is never put off
+        size_t first = level;
+        while (level > 0 && first < level + ISO_COARSE_LEVELS && first < coarsest_level(*model) &&
+            level_samples(*model, first) > ISO_SYNC_SAMPLES) {
+            first++;
+        }
+
+        if (!field_grid || level == 0) {
+            set_grid(sample_level(*model, native_grid, first));
+            grid_level = first;
+            field_grid = true;
+            if (first == level) {
+                return;
+            }
+            first--;
+        }
+        else if (grid_level > level) {
+            first = std::min(first, grid_level - 1);
+        }
+        else {
+            // A finer grid stays on show until the coarser one is ready
+            first = level;
+        }
+
+        stop_refining.store(false, std::memory_order_release);
+        grid_thread = std::thread([this, model, native = native_grid, first, level] {
+            for (size_t l = first + 1; l-- > level;) {
+                GridLevel refined = {.grid = sample_level(*model, native, l, &stop_refining), .level = l};
+                if (stop_refining.load(std::memory_order_acquire)) {
+                    return;
+                }
+
+                std::lock_guard<std::mutex> lock(grid_lock);
+                pending_grid = std::move(refined);
+            }
+        });
+    }
+
+    // Grids sampled for an older request are dropped. Sampling checks the flag every z slice, so the join
+    // only waits for the slices already started.
+    void FieldEntity::stop_refinement() {
+        stop_refining.store(true, std::memory_order_release);
+        if (grid_thread.joinable()) {
+            grid_thread.join();
+        }
+        pending_grid.reset();
+    }
+
+    bool FieldEntity::update_grid() {
+        std::optional<GridLevel> refined;
+        {
+            std::lock_guard<std::mutex> lock(grid_lock);
+            refined.swap(pending_grid);
+        }
+        if (!refined) {
+            return false;
+        }
+
+        set_grid(std::move(refined->grid));
+        grid_level = refined->level;
+        return true;
+    }
+
+    // Picks the level where a cell covers ISO_LOD_CELL_PIXELS of the bounding box on screen, or a coarser one
+    // when the surface just drawn would exceed the triangle budget there. Triangles grow about 4 times a level.
+    void FieldEntity::update_level(const Matrix4f& mvp, int width, int height) {
+        if (!lod_resolution || !field_grid || surfaces.empty()) {
+            return;
+        }
+        auto& drawn = surfaces.front();
+        if (drawn.grid_version != grid_version || drawn.iso_value != iso_value) {
+            return;
+        }
+
+        auto& model = *geometry_entity->model;
+        Vector3f size(model.spacing.x * model.nx, model.spacing.y * model.ny, model.spacing.z * model.nz);
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        bool behind = false;
+        for (int corner = 0; corner < 8; corner++) {
+            auto p = model.origin + Vector3f(corner & 1 ? size.x : 0, corner & 2 ? size.y : 0, corner & 4 ? size.z : 0);
+            auto clip = mvp * Vector4f(p.x, p.y, p.z, 1);
+            if (clip.w <= 0) {
+                behind = true;
+                break;
+            }
+            min_x = std::min(min_x, clip.x / clip.w);
+            max_x = std::max(max_x, clip.x / clip.w);
+            min_y = std::min(min_y, clip.y / clip.w);
+            max_y = std::max(max_y, clip.y / clip.w);
+        }
+
+        // With the camera inside the box every voxel may be close up
+        size_t coarsest = coarsest_level(model);
+        size_t level = 0;
+        if (!behind) {
+            float extent = 0.5f * std::max((max_x - min_x) * width, (max_y - min_y) * height);
+            float voxels = std::max({model.nx, model.ny, model.nz});
+            while (level < coarsest && extent * (size_t(1) << level) / voxels < ISO_LOD_CELL_PIXELS) {
+                level++;
+            }
+        }
+
+        auto triangles = drawn.index_count / 3 * std::pow(4.0, static_cast<double>(grid_level) - level);
+        while (level < coarsest && triangles > ISO_TRIANGLE_BUDGET) {
+            level++;
+            triangles /= 4;
+        }
+
+        if (level != target_level) {
+            regrid(level);
+        }
+    }
+
+    void FieldEntity::extract_surface(SurfaceBuffers& surface) {
+        // The mesh only lives until it is on the GPU
+        IsoMesh mesh;
+        extract_isosurface(*grid, iso_value, mesh);
+
+        glBindVertexArray(surface.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, surface.vbo);
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(IsoVertex), mesh.vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, surface.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(),
+            GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        surface.index_count = mesh.indices.size();
+        surface.grid_version = grid_version;
+        surface.iso_value = iso_value;
+        surface.gpu = false;
+    }
+
+    void FieldEntity::upload_grid() {
+        if (grid_tex_version == grid_version) {
+            return;
+        }
+
+        // Rows of 8 and 16 bit texels are not padded to 4 bytes
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        glBindTexture(GL_TEXTURE_3D, grid_tex);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R16UI, grid->nx, grid->ny, grid->nz, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT,
+            grid->values.data());
+        glBindTexture(GL_TEXTURE_3D, grid_col_tex);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, grid->nx, grid->ny, grid->nz, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+            grid->color_ids.data());
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+        grid_tex_version = grid_version;
+    }
+
+    // Cells of the bricks the surface passes through are classified and their triangle counts turned into
+    // offsets by a prefix sum, then every cell writes its triangles after those of the cells before it along
+    // with the draw command. Other bricks cost nothing on the GPU. The total is read back once to size the
+    // vertex buffer, drawing needs nothing from the CPU.
+    void FieldEntity::extract_surface_gpu(SurfaceBuffers& surface) {
+        auto& pipelines = geometry_entity->pipelines;
+        auto classify = static_cast<IsoClassifyPipeline*>(pipelines[static_cast<int>(PipelineType::ISO_CLASSIFY)]);
+        auto scan = static_cast<IsoScanPipeline*>(pipelines[static_cast<int>(PipelineType::ISO_SCAN)]);
+        auto scan_add = static_cast<IsoScanPipeline*>(pipelines[static_cast<int>(PipelineType::ISO_SCAN_ADD)]);
+        auto emit = static_cast<IsoEmitPipeline*>(pipelines[static_cast<int>(PipelineType::ISO_EMIT)]);
+
+        surface.grid_version = grid_version;
+        surface.iso_value = iso_value;
+        surface.gpu = true;
+        surface.index_count = 0;
+
+        // Only the bricks the surface passes through are dispatched, there may be none
+        auto threshold = iso_threshold(iso_value);
+        find_active_bricks(*grid, threshold, active_bricks);
+        if (active_bricks.empty()) {
+            const GLuint empty[4] = {0, 1, 0, 0};
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, surface.indirect);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(empty), empty);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+
+        upload_grid();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, brick_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, active_bricks.size() * sizeof(uint32_t), active_bricks.data(),
+            GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, brick_buffer);
+
+        const size_t brick_cells = ISO_BRICK_CELLS * ISO_BRICK_CELLS * ISO_BRICK_CELLS;
+        std::vector<size_t> sizes = {active_bricks.size() * brick_cells};
+        do {
+            sizes.push_back((sizes.back() + ISO_SCAN_BLOCK - 1) / ISO_SCAN_BLOCK);
+        } while (sizes.back() > 1);
+
+        if (sizes != scan_sizes) {
+            glDeleteBuffers(scan_buffers.size(), scan_buffers.data());
+            scan_buffers.resize(sizes.size());
+            glGenBuffers(scan_buffers.size(), scan_buffers.data());
+            for (size_t l = 0; l < sizes.size(); l++) {
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, scan_buffers[l]);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, sizes[l] * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+            }
+            scan_sizes = sizes;
+        }
+
+        // This runs in the middle of a draw, whose program is put back at the end
+        GLint draw_program;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &draw_program);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_3D, grid_tex);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_3D, grid_col_tex);
+
+        glUseProgram(classify->shader_program);
+        glUniform3ui(classify->uDims, grid->nx, grid->ny, grid->nz);
+        glUniform1i(classify->uThreshold, threshold);
+        glUniform3ui(classify->uBricks, brick_count(grid->nx), brick_count(grid->ny), brick_count(grid->nz));
+        glUniform1ui(classify->uBrickCount, active_bricks.size());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scan_buffers[0]);
+        dispatch_groups(active_bricks.size());
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // Each level is scanned within blocks, whose sums make up the next level. The last level holds the total.
+        glUseProgram(scan->shader_program);
+        for (size_t l = 0; l + 1 < scan_sizes.size(); l++) {
+            glUniform1ui(scan->uCount, scan_sizes[l]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scan_buffers[l]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, scan_buffers[l + 1]);
+            dispatch_groups(scan_sizes[l + 1]);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        // Then the scanned block sums are added back down, from the level below the single block at the top
+        glUseProgram(scan_add->shader_program);
+        for (size_t l = scan_sizes.size() - 2; l-- > 0;) {
+            glUniform1ui(scan_add->uCount, scan_sizes[l]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scan_buffers[l]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, scan_buffers[l + 1]);
+            dispatch_groups(scan_sizes[l + 1]);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        GLuint triangles = 0;
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scan_buffers.back());
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(triangles), &triangles);
+        surface.index_count = 3 * triangles;
+
+        glBindBuffer(GL_ARRAY_BUFFER, surface.vbo);
+        glBufferData(GL_ARRAY_BUFFER, std::max<size_t>(3 * triangles, 1) * sizeof(IsoVertex), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glUseProgram(emit->shader_program);
+        glUniform3ui(emit->uDims, grid->nx, grid->ny, grid->nz);
+        glUniform1i(emit->uThreshold, threshold);
+        glUniform3ui(emit->uBricks, brick_count(grid->nx), brick_count(grid->ny), brick_count(grid->nz));
+        glUniform1ui(emit->uBrickCount, active_bricks.size());
+        glUniform1f(emit->uIsoValue, iso_value * DISTANCE_FIELD_ONE);
+        glUniform3fv(emit->uOrigin, 1, grid->origin);
+        glUniform3fv(emit->uStep, 1, grid->step);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scan_buffers[0]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, surface.vbo);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, surface.indirect);
+        dispatch_groups(active_bricks.size());
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        glActiveTexture(GL_TEXTURE0);
+        glUseProgram(draw_program);
+    }
+
+    // Only a new grid or isovalue needs an extraction, colours are switched by the shader. Otherwise the
+    // surface is drawn from the buffers it was left in.
+    FieldEntity::SurfaceBuffers& FieldEntity::get_surface() {
+        auto hit = std::ranges::find_if(surfaces, [this] (const SurfaceBuffers& surface) {
+            return surface.grid_version == grid_version && surface.iso_value == iso_value &&
+                surface.gpu == gpu_extraction;
+        });
+        if (hit != surfaces.end()) {
+            surfaces.splice(surfaces.begin(), surfaces, hit);
+            return surfaces.front();
+        }
+
+        // Buffers of surfaces from an older grid are taken first, then those of the least recently drawn one
+        auto slot = std::ranges::find_if(surfaces, [this] (const SurfaceBuffers& surface) {
+            return surface.grid_version != grid_version;
+        });
+        if (slot == surfaces.end() && surfaces.size() < ISO_SURFACE_CACHE) {
+            surfaces.emplace_front();
+            create_surface_buffers(surfaces.front());
+            slot = surfaces.begin();
+        }
+        else if (slot == surfaces.end()) {
+            slot = std::prev(surfaces.end());
+        }
+
+        surfaces.splice(surfaces.begin(), surfaces, slot);
+        if (gpu_extraction) {
+            extract_surface_gpu(surfaces.front());
+        }
+        else {
+            extract_surface(surfaces.front());
+        }
+        return surfaces.front();
+    }
+
+    bool FieldEntity::update_preview() {
+        std::optional<DistancePreview> preview;
+        {
+            std::lock_guard<std::mutex> lock(preview_lock);
+            preview.swap(pending_preview);
+        }
+        if (!preview) {
+            return false;
+        }
+
+        // Previews are shown at their own resolution
+        auto preview_grid = std::make_shared<IsoGrid>();
+        sample_grid(*geometry_entity->model, preview->nx, preview->ny, preview->nz, preview->field.data(),
+            preview->color_ids.data(), preview->nx, preview->ny, preview->nz, *preview_grid);
+        set_grid(std::move(preview_grid));
+        field_grid = false;
+        set_draw_mode = true;
+        return true;
     }
 
     void FieldEntity::complete_set_traits() {
@@ -231,8 +530,10 @@ namespace MVF {
             worker_thread.join();
         }
         
+        // A preview that was not picked up in time is older than anything below
+        pending_preview.reset();
         if (compute_passed) {
-            build_texture();
+            build_grid();
         }
         dist_fld_lock.unlock();
     }
@@ -247,6 +548,9 @@ namespace MVF {
         }
 
         dist_fld_lock.lock();
+        // The field is about to be overwritten
+        stop_refinement();
+        field_grid = false;
 
         this->attrib_comps = attrib_comps;
         this->traits = traits;
@@ -310,10 +614,11 @@ namespace MVF {
             }
         }
 
-        worker_thread = std::thread([this] {
+        // The options may be changed from the UI while the worker runs, it keeps the ones this call was made with
+        worker_thread = std::thread([this, options = dist_options] {
             stop_requested.store(false, std::memory_order_release);
             compute_passed = true;
-            build_distance_field();
+            build_distance_field(options);
             advance_ui_clock(1, true);
         });
     }
@@ -332,6 +637,26 @@ namespace MVF {
         is_apply_color = apply_color;   
     }
 
+    void FieldEntity::set_lookup_table(bool lookup_table) {
+        dist_options.lookup_table = lookup_table;
+    }
+
+    void FieldEntity::set_incremental(bool incremental) {
+        dist_options.incremental = incremental;
+    }
+
+    void FieldEntity::set_gpu_extraction(bool gpu_extraction) {
+        this->gpu_extraction = gpu_extraction;
+    }
+
+    // Without LOD the field is extracted at its own resolution again, with it the level is picked on the next frame
+    void FieldEntity::set_lod_resolution(bool lod_resolution) {
+        this->lod_resolution = lod_resolution;
+        if (!lod_resolution && field_grid && target_level != 0) {
+            regrid(0);
+        }
+    }
+
     void FieldEntity::clear_traits() {
         set_draw_mode = false;
     }
@@ -341,14 +666,16 @@ namespace MVF {
             return;
         }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_3D, tex3d);
-        
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_3D, tex3d_col);
-        
-        glBindVertexArray(vao);
-        glDrawArrays(GL_POINTS, 0, res_x * res_y * res_z);
+        auto& surface = get_surface();
+        glBindVertexArray(surface.vao);
+        if (surface.gpu) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, surface.indirect);
+            glDrawArraysIndirect(GL_TRIANGLES, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        else {
+            glDrawElements(GL_TRIANGLES, surface.index_count, GL_UNSIGNED_INT, 0);
+        }
         glBindVertexArray(0); 
     }
 	
@@ -366,7 +693,6 @@ namespace MVF {
 
         // There are 2 entities here. SpatialRenderer::entity takes care of transforms, camera, lighting, bounding box etc
         // Our entity is responsible for displaying computed distance field
-        auto limits = Vector3f(SpatialRenderer::entity.model->nx, SpatialRenderer::entity.model->ny, SpatialRenderer::entity.model->nz);
 		Matrix4f mvp = projection * camera.view * SpatialRenderer::entity.world * SpatialRenderer::entity.scale_transform * SpatialRenderer::entity.init_transform;
 		Matrix4f mp = SpatialRenderer::entity.world * SpatialRenderer::entity.scale_transform * SpatialRenderer::entity.init_transform;
 		auto light_position = light.get_position();
@@ -378,14 +704,10 @@ namespace MVF {
 		glUniformMatrix4fv(pipeline->uMVP, 1, GL_TRUE, &mvp.m[0][0]);
 		glUniform3fv(pipeline->uLightPos, 1, light_position);
 		glUniform3fv(pipeline->uViewPos, 1, camera_position);
-        glUniform1f(pipeline->uIsoValue, entity.iso_value);
-        glUniform3fv(pipeline->uOrigin, 1, SpatialRenderer::entity.model->origin);
-        glUniform3fv(pipeline->uSpacing, 1, SpatialRenderer::entity.model->spacing);
-        glUniform3fv(pipeline->uLimits, 1, limits);
-        glUniform3fv(pipeline->uSteps, 1, entity.steps); 
         glUniform1i(pipeline->uApplyColor, entity.is_apply_color); 
 
         entity.draw();
+        entity.update_level(mvp, width, height);
     }
 
 }
\ No newline at end of file
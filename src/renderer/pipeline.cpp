@@ -1,6 +1,7 @@
 #include "vtk.h"
 #include "error.h"
 #include "pipeline.h"
+#include "attrib.h"
 
 namespace MVF{
     Pipeline::Pipeline(PipelineType type) : type(type) {
@@ -18,6 +19,10 @@ namespace MVF{
     Pipeline::Pipeline(const std::string& vs_file, const std::string& gs_file, const std::string& fs_file, PipelineType type) : Pipeline(type) {
         compile_shaders(vs_file, gs_file, fs_file);
     }
+
+    Pipeline::Pipeline(const std::string& cs_file, PipelineType type) : Pipeline(type) {
+        compile_compute_shader(cs_file);
+    }
     
     void Pipeline::add_shader(const char* shader_text, GLenum shader_type) {
 		GLuint shader_obj = glCreateShader(shader_type);
@@ -69,6 +74,21 @@ namespace MVF{
         }
 		add_shader(fs.c_str(), GL_FRAGMENT_SHADER);
 
+        link_program();
+    }
+
+    void Pipeline::compile_compute_shader(const std::string& cs_file) {
+        std::string cs;
+        if (!read_file(cs_file, cs)) {
+            std::cerr << "Compute shader file missing! -> " << cs_file << std::endl;
+            exit(1);
+        }
+
+        add_shader(cs.c_str(), GL_COMPUTE_SHADER);
+        link_program();
+    }
+
+    void Pipeline::link_program() {
 		GLint success = 0;
 		GLchar error_log[1024] = {0};
 		
@@ -137,19 +157,45 @@ namespace MVF{
         uAlpha = get_uniform_var("uAlpha");
     }
     
-    IsoPipeline::IsoPipeline() : Pipeline("shaders/iso.vs", "shaders/iso.gs", "shaders/phong_shading.fs", PipelineType::ISO) {
+    IsoPipeline::IsoPipeline() : Pipeline("shaders/iso.vs", "shaders/phong_shading.fs", PipelineType::ISO) {
         uMVP = get_uniform_var("uMVP");
         uM = get_uniform_var("uM");
-        uIsoValue = get_uniform_var("uIsoValue");
-        uOrigin = get_uniform_var("uOrigin");
-        uLimits = get_uniform_var("uLimits");
-        uSpacing = get_uniform_var("uSpacing");
-        uSteps = get_uniform_var("uSteps");
         uLightPos = get_uniform_var("uLightPos");
         uViewPos = get_uniform_var("uViewPos");
         uApplyColor = get_uniform_var("uApplyColor");
-        
-        glUniform1i(glGetUniformLocation(shader_program, "volume_tex"), 0);
+
+        float palette[3 * MAX_COLORS];
+        for (size_t i = 0; i < MAX_COLORS; i++) {
+            palette[3 * i] = global_color_pallete[i].x;
+            palette[3 * i + 1] = global_color_pallete[i].y;
+            palette[3 * i + 2] = global_color_pallete[i].z;
+        }
+        glUniform3fv(glGetUniformLocation(shader_program, "uPalette"), MAX_COLORS, palette);
+    }
+
+    IsoClassifyPipeline::IsoClassifyPipeline() : Pipeline("shaders/iso_classify.cs", PipelineType::ISO_CLASSIFY) {
+        uDims = get_uniform_var("uDims");
+        uThreshold = get_uniform_var("uThreshold");
+        uBricks = get_uniform_var("uBricks");
+        uBrickCount = get_uniform_var("uBrickCount");
+
+        glUniform1i(glGetUniformLocation(shader_program, "field_tex"), 0);
+    }
+
+    IsoScanPipeline::IsoScanPipeline(const std::string& cs_file, PipelineType type) : Pipeline(cs_file, type) {
+        uCount = get_uniform_var("uCount");
+    }
+
+    IsoEmitPipeline::IsoEmitPipeline() : Pipeline("shaders/iso_emit.cs", PipelineType::ISO_EMIT) {
+        uDims = get_uniform_var("uDims");
+        uThreshold = get_uniform_var("uThreshold");
+        uBricks = get_uniform_var("uBricks");
+        uBrickCount = get_uniform_var("uBrickCount");
+        uIsoValue = get_uniform_var("uIsoValue");
+        uOrigin = get_uniform_var("uOrigin");
+        uStep = get_uniform_var("uStep");
+
+        glUniform1i(glGetUniformLocation(shader_program, "field_tex"), 0);
         glUniform1i(glGetUniformLocation(shader_program, "color_tex"), 1);
     }
         
@@ -161,7 +207,9 @@ namespace MVF{
         std::vector<Pipeline*> pipelines;
         if (is_spatial_pipeline) {
             // *Order must match PipelineType enum ordering for spatial domain*
-            pipelines = {new VecGlyphPipeline(), new BoxPipeline(), new IsoPipeline(), new SlicePipeline(), new DvrPipeline()};
+            pipelines = {new VecGlyphPipeline(), new BoxPipeline(), new IsoPipeline(), new SlicePipeline(), new DvrPipeline(),
+                new IsoClassifyPipeline(), new IsoScanPipeline("shaders/iso_scan.cs", PipelineType::ISO_SCAN),
+                new IsoScanPipeline("shaders/iso_scan_add.cs", PipelineType::ISO_SCAN_ADD), new IsoEmitPipeline()};
 #ifdef MVF_DEBUG
         std::cout << "Created spatial pipeline of size: " << pipelines.size() << std::endl;
 #endif
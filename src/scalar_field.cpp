@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <stdexcept>
+#include "scalar_field.h"
+
+namespace MVF {
+    size_t get_field_type_size(FieldType type) {
+        switch (type) {
+            case FieldType::FLOAT32: return sizeof(float);
+            case FieldType::UINT8: return sizeof(uint8_t);
+            case FieldType::INT8: return sizeof(int8_t);
+            case FieldType::UINT16: return sizeof(uint16_t);
+            case FieldType::INT16: return sizeof(int16_t);
+        }
+
+        return 0;
+    }
+
+    ScalarField::ScalarField(FieldType type, size_t size) {
+        switch (type) {
+            case FieldType::FLOAT32: storage = std::vector<float>(size); break;
+            case FieldType::UINT8: storage = std::vector<uint8_t>(size); break;
+            case FieldType::INT8: storage = std::vector<int8_t>(size); break;
+            case FieldType::UINT16: storage = std::vector<uint16_t>(size); break;
+            case FieldType::INT16: storage = std::vector<int16_t>(size); break;
+            default: throw std::invalid_argument("Unknown field type");
+        }
+    }
+
+    ScalarField::ScalarField(std::vector<float>&& values) : storage(std::move(values)) {}
+
+    FieldType ScalarField::type() const {
+        return static_cast<FieldType>(storage.index());
+    }
+
+    size_t ScalarField::size() const {
+        return std::visit([] (auto& values) { return values.size(); }, storage);
+    }
+
+    size_t ScalarField::element_size() const {
+        return get_field_type_size(type());
+    }
+
+    size_t ScalarField::byte_size() const {
+        return size() * element_size();
+    }
+
+    bool ScalarField::empty() const {
+        return size() == 0;
+    }
+
+    void* ScalarField::data() {
+        return std::visit([] (auto& values) -> void* { return values.data(); }, storage);
+    }
+
+    const void* ScalarField::data() const {
+        return std::visit([] (auto& values) -> const void* { return values.data(); }, storage);
+    }
+
+    void ScalarField::read(size_t first, size_t count, float* dest) const {
+        visit([first, count, dest] (auto* values) {
+            std::transform(values + first, values + first + count, dest, [] (auto v) {
+                return static_cast<float>(v);
+            });
+        });
+    }
+
+    std::vector<float> ScalarField::to_float() const {
+        std::vector<float> out(size());
+        read(0, out.size(), out.data());
+        return out;
+    }
+
+    std::pair<float, float> ScalarField::minmax() const {
+        if (empty()) {
+            return {0.0f, 0.0f};
+        }
+
+        return visit([this] (auto* values) {
+            auto [mn, mx] = std::minmax_element(values, values + size());
+            return std::pair<float, float>(static_cast<float>(*mn), static_cast<float>(*mx));
+        });
+    }
+}
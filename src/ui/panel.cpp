@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <ranges>
 #include "panel.h"
 #include "renderer.h"
@@ -30,7 +31,10 @@ SpatialPanel::SpatialPanel(MVF::SpatialHandler* handler) : handler(handler), sli
         auto spatial_renderer = static_cast<MVF::SpatialRenderer*>(this->handler->renderer);
         if (text == "Glyph" && selected_mode != Selection::GLYPH) {
             this->handler->make_current();
-            if (selected_comps.size() == 2) {
+            if (selected_comps.size() == 1) {
+                spatial_renderer->entity.set_vector_mode(selected_comps[0]);
+            }
+            else if (selected_comps.size() == 2) {
                 spatial_renderer->entity.set_vector_mode(selected_comps[0], selected_comps[1]);
             }
             else {
@@ -141,6 +145,27 @@ void SpatialPanel::on_selection() {
         return;
     }
 
+    auto is_group = [this] (const std::string& comp) {
+        return data->groups.contains(comp);
+    };
+    bool has_group = std::ranges::any_of(comps, is_group);
+    if (has_group && comps.size() > 1) {
+        MVF::app_warn("A vector field must be selected on its own");
+        comp_list.set_active_mask(selected_comps);
+        return;
+    }
+
+    // Fields are parsed the first time they are picked, the selection is applied again once they are in
+    auto request = request_fields(comps, [this] { comp_list.emit_selection(); });
+    if (request == FieldRequest::PENDING) {
+        return;
+    }
+    if (request == FieldRequest::BUSY) {
+        MVF::app_warn("Please wait for the current operation to finish");
+        comp_list.set_active_mask(selected_comps);
+        return;
+    }
+
     selected_comps = comps;
     
     // Clear all but first entry (None) to avoid duplicates
@@ -150,7 +175,7 @@ void SpatialPanel::on_selection() {
         }
     }
     
-    if (comps.size() > 1) {
+    if (comps.size() > 1 || has_group) {
         rep_menu.append("Glyph");
     }
     else if (comps.size() == 1) {
@@ -173,6 +198,13 @@ void SpatialPanel::load_model(std::shared_ptr<MVF::VolumeData>& data) {
         return field.first;
     }) | std::ranges::to<std::vector<std::string>>();
 
+    // Vector arrays can also be picked as a whole to be drawn as glyphs
+    for (auto& [group, comps] : this->data->groups) {
+        if (comps.size() <= 3) {
+            field_comps.push_back(group);
+        }
+    }
+
     comp_list.update_list(field_comps);
 
     // Clear all but first entry (None) to avoid duplicates
@@ -249,6 +281,16 @@ void AttributePanel::on_selection() {
         return;
     }
 
+    auto request = request_fields(comps, [this] { comp_list.emit_selection(); });
+    if (request == FieldRequest::PENDING) {
+        return;
+    }
+    if (request == FieldRequest::BUSY) {
+        MVF::app_warn("Please wait for the current operation to finish");
+        comp_list.set_active_mask(selected_comps);
+        return;
+    }
+
     selected_comps = comps;
     auto desc = comps | std::views::transform([] (auto& name) {
         return MVF::AxisDesc{
@@ -327,6 +369,22 @@ void FieldPanel::complete_set_traits() {
     handler->queue_render();
 }
 
+void FieldPanel::update_preview() {
+    handler->make_current();
+    auto field_handler = static_cast<MVF::FieldRenderer*>(handler->renderer); 
+    if (field_handler->entity.update_preview()) {
+        handler->queue_render();
+    }
+}
+
+bool FieldPanel::update_grid() {
+    auto field_handler = static_cast<MVF::FieldRenderer*>(handler->renderer); 
+    if (field_handler->entity.update_grid()) {
+        handler->queue_render();
+    }
+    return true;
+}
+
 void FieldPanel::clear_traits() {
     disable_panel();
 
@@ -340,12 +398,24 @@ void FieldPanel::enable_panel() {
     rep_menu.set_sensitive(true);
     iso_slider.set_sensitive(true);
     apply_color.set_sensitive(true);
+    lookup_table.set_sensitive(true);
+    incremental.set_sensitive(true);
+    gpu_extraction.set_sensitive(true);
+    lod_resolution.set_sensitive(true);
+    if (!refine_conn.connected()) {
+        refine_conn = Glib::signal_timeout().connect(sigc::mem_fun(*this, &FieldPanel::update_grid), 16);
+    }
 }
 
 void FieldPanel::disable_panel() {
     rep_menu.set_sensitive(false);
     iso_slider.set_sensitive(false);
     apply_color.set_sensitive(false);
+    lookup_table.set_sensitive(false);
+    incremental.set_sensitive(false);
+    gpu_extraction.set_sensitive(false);
+    lod_resolution.set_sensitive(false);
+    refine_conn.disconnect();
 }
 
 FieldPanel::FieldPanel(MVF::SpatialHandler* handler) : handler(handler), iso_slider([this]() {
@@ -366,6 +436,13 @@ FieldPanel::FieldPanel(MVF::SpatialHandler* handler) : handler(handler), iso_sli
     rep_box->append(rep_menu);    
    
     apply_color = CheckButton("Apply colormap");
+    lookup_table = CheckButton("Approximate with lookup table");
+    lookup_table.set_tooltip_text("Faster for 1 to 3 components, takes effect on the next trait change");
+    incremental = CheckButton("Update incrementally on trait changes");
+    incremental.set_tooltip_text("Keeps 16 bytes per voxel so that a trait change only ranks the voxels it affects");
+    gpu_extraction = CheckButton("Extract isosurface on the GPU");
+    lod_resolution = CheckButton("Pick grid resolution from the view");
+    lod_resolution.set_tooltip_text("Coarser grids for small or distant volumes and surfaces over 2M triangles");
 
     auto spacer = make_managed<Box>(Orientation::VERTICAL);
     spacer->set_vexpand(true);
@@ -373,6 +450,10 @@ FieldPanel::FieldPanel(MVF::SpatialHandler* handler) : handler(handler), iso_sli
     vbox->append(*rep_box);
     vbox->append(iso_slider);
     vbox->append(apply_color);
+    vbox->append(lookup_table);
+    vbox->append(incremental);
+    vbox->append(gpu_extraction);
+    vbox->append(lod_resolution);
     vbox->append(*spacer);
 
     apply_color.signal_toggled().connect([this] {
@@ -380,6 +461,24 @@ FieldPanel::FieldPanel(MVF::SpatialHandler* handler) : handler(handler), iso_sli
         this->handler->queue_render();
     });
 
+    lookup_table.signal_toggled().connect([this] {
+        static_cast<MVF::FieldRenderer*>(this->handler->renderer)->entity.set_lookup_table(lookup_table.get_active());
+    });
+
+    incremental.signal_toggled().connect([this] {
+        static_cast<MVF::FieldRenderer*>(this->handler->renderer)->entity.set_incremental(incremental.get_active());
+    });
+
+    gpu_extraction.signal_toggled().connect([this] {
+        static_cast<MVF::FieldRenderer*>(this->handler->renderer)->entity.set_gpu_extraction(gpu_extraction.get_active());
+        this->handler->queue_render();
+    });
+
+    lod_resolution.signal_toggled().connect([this] {
+        static_cast<MVF::FieldRenderer*>(this->handler->renderer)->entity.set_lod_resolution(lod_resolution.get_active());
+        this->handler->queue_render();
+    });
+
     disable_panel();
     set_child(*vbox);
 }
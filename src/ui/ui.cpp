@@ -1,4 +1,5 @@
 #include <iostream>
+#include <filesystem>
 #include "ui.h"
 #include "error.h"
 #include "attrib.h"
@@ -238,6 +239,12 @@ spatial_panel(&spatial_handler), attrib_panel(&attrib_handler), field_panel(&fie
         attrib_panel.comp_list.set_sensitive(false);
     });
 
+    auto field_requester = [this] (const std::vector<std::string>& names, std::function<void()> on_loaded) {
+        return request_fields(names, on_loaded);
+    };
+    spatial_panel.set_field_requester(field_requester);
+    attrib_panel.set_field_requester(field_requester);
+
     attrib_panel.comp_list.set_secondary_handler([this] {
         if (!attrib_panel.handle_changed_selection) {
             return;
@@ -278,6 +285,7 @@ bool MainWindow::generic_async_handler() {
     }
 
     progress_bar.set_fraction(async_progress);
+    field_panel.update_preview();
     return true;
 }
     
@@ -365,8 +373,10 @@ void MainWindow::on_file_open() {
     );
 
     auto vtk_filter = Gtk::FileFilter::create();
-    vtk_filter->set_name("VTK files");
-    vtk_filter->add_pattern("*.vtk"); 
+    vtk_filter->set_name("Volume files");
+    vtk_filter->add_pattern("*.vtk");
+    vtk_filter->add_pattern("*.vti");
+    vtk_filter->add_pattern("*.raw");
     dialog->add_filter(vtk_filter);
 
     dialog->show();
@@ -383,20 +393,39 @@ void MainWindow::on_file_open() {
                 return;
             }
 
-            loader = MVF::open_vtk_async(filename);
-            if (loader->read_failed) {
-                MVF::app_warn("File format not supported");
+            // Raw volumes carry no header, so their layout is confirmed by the user first
+            auto ext = std::filesystem::path(filename).extension().string();
+            if (ext == ".raw" || ext == ".RAW") {
+                MVF::RawVolumeInfo info;
+                MVF::guess_raw_info(filename, info);
+                raw_dialog = std::make_unique<RawImportDialog>(*this, info, [this, filename] (const MVF::RawVolumeInfo& info) {
+                    if (is_async_ui_state || file_loader_conn.connected()) {
+                        return;
+                    }
+                    start_file_load(filename, MVF::open_raw_async(filename, info));
+                });
+                raw_dialog->set_visible(true);
                 return;
             }
-            
-            vtk_filename = filename;
-            progress_bar.show();
-            file_loader_conn = Glib::signal_timeout().connect(sigc::mem_fun(*this, &MainWindow::file_load_handler), 16);
-            loader->load();
+
+            start_file_load(filename, MVF::open_volume_async(filename));
         }
     });
 }
 
+void MainWindow::start_file_load(const std::string& filename, std::unique_ptr<MVF::LoadProxy> proxy) {
+    loader = std::move(proxy);
+    if (loader->read_failed) {
+        MVF::app_warn("File format not supported");
+        return;
+    }
+
+    vtk_filename = filename;
+    progress_bar.show();
+    file_loader_conn = Glib::signal_timeout().connect(sigc::mem_fun(*this, &MainWindow::file_load_handler), 16);
+    loader->load();
+}
+
 bool MainWindow::file_load_handler() {
     if (loader->read_failed) {
         MVF::app_warn("Invalid file format");
@@ -408,10 +437,12 @@ bool MainWindow::file_load_handler() {
     auto bytes_read = loader->num_bytes_read.load(std::memory_order_relaxed);
     auto fraction = static_cast<double>(bytes_read) / loader->total_bytes;
     progress_bar.set_fraction(fraction);
+    progress_bar.set_detail(loader->stats.progress_text(fraction));
     
-    if (bytes_read == loader->total_bytes) {
+    if (loader->load_finished.load(std::memory_order_acquire)) {
         loader->complete();
         progress_bar.hide();
+        std::cout << "Opened " << vtk_filename << ": " << loader->stats.summary() << std::endl;
 #ifdef MVF_DEBUG
         std::cout << "Loaded VTK: " << loader->data->nx << " x " << loader->data->ny << " x " << loader->data->nz << " with fields:" << std::endl;
 
@@ -445,4 +476,49 @@ bool MainWindow::file_load_handler() {
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+MVFPanel::FieldRequest MainWindow::request_fields(const std::vector<std::string>& names, std::function<void()> on_loaded) {
+    if (is_async_ui_state || file_loader_conn.connected()) {
+        return MVFPanel::FieldRequest::BUSY;
+    }
+
+    if (!loader || !loader->load_fields(names)) {
+        return MVFPanel::FieldRequest::READY;
+    }
+
+    on_fields_loaded = on_loaded;
+    progress_bar.show();
+    progress_bar.set_fraction(0);
+    file_loader_conn = Glib::signal_timeout().connect(sigc::mem_fun(*this, &MainWindow::field_load_handler), 16);
+    return MVFPanel::FieldRequest::PENDING;
+}
+
+bool MainWindow::field_load_handler() {
+    if (loader->read_failed) {
+        MVF::app_warn("Unable to load the selected fields");
+        loader->complete();
+        progress_bar.hide();
+        file_loader_conn.disconnect();
+        return false;
+    }
+
+    auto bytes_read = loader->num_bytes_read.load(std::memory_order_relaxed);
+    auto fraction = static_cast<double>(bytes_read) / loader->total_bytes;
+    progress_bar.set_fraction(fraction);
+    progress_bar.set_detail(loader->stats.progress_text(fraction));
+
+    if (loader->load_finished.load(std::memory_order_acquire)) {
+        loader->complete();
+        progress_bar.hide();
+        std::cout << "Loaded fields of " << vtk_filename << ": " << loader->stats.summary() << std::endl;
+        // The connection has to be gone before the selection is applied again, otherwise it is seen as busy
+        file_loader_conn.disconnect();
+        auto on_loaded = std::move(on_fields_loaded);
+        on_fields_loaded = nullptr;
+        on_loaded();
+        return false;
+    }
+
+    return true;
+}
@@ -32,12 +32,26 @@ void OverlayProgressBar::hide() {
     progress_bar.set_opacity(0.0);
     label_progress.set_opacity(0.0);
     progress_bar.set_sensitive(false);
+    detail.clear();
 }
 
 void OverlayProgressBar::set_fraction(double frac) {
     progress_bar.set_fraction(frac);
-    int pct = static_cast<int>(frac * 100);
-    label_progress.set_text(std::to_string(pct) + "%");
+    percent = static_cast<int>(frac * 100);
+    update_label();
+}
+
+void OverlayProgressBar::set_detail(const std::string& text) {
+    detail = text;
+    update_label();
+}
+
+void OverlayProgressBar::update_label() {
+    auto text = std::to_string(percent) + "%";
+    if (!detail.empty()) {
+        text += "  |  " + detail;
+    }
+    label_progress.set_text(text);
 }
 
 HoverOverlay::HoverOverlay() {
@@ -102,10 +116,7 @@ Gtk::Box(Gtk::Orientation::VERTICAL), handler(fn) {
     popover.set_child(vbox);
     
     popover.signal_closed().connect([this]() {
-        handler();
-        if (secondary_handler) {
-            secondary_handler();
-        }
+        emit_selection();
         is_popover_visible = false;
     });
     
@@ -121,6 +132,13 @@ void MultiSelectCombo::set_secondary_handler(std::function<void()> handler) {
     secondary_handler = handler;
 }
 
+void MultiSelectCombo::emit_selection() {
+    handler();
+    if (secondary_handler) {
+        secondary_handler();
+    }
+}
+
 MultiSelectCombo::~MultiSelectCombo() {
     popover.unparent();
 }
@@ -187,3 +205,86 @@ Slider::Slider(std::function<void()> handler) {
     signal_value_changed().connect(handler);
 }
 
+
+RawImportDialog::RawImportDialog(Gtk::Window& parent, const MVF::RawVolumeInfo& info, std::function<void(const MVF::RawVolumeInfo&)> on_accept)
+    : on_accept(on_accept) {
+    set_title("Import raw volume");
+    set_transient_for(parent);
+    set_modal(true);
+    set_resizable(false);
+
+    grid.set_row_spacing(5);
+    grid.set_column_spacing(5);
+
+    auto add_label = [this] (const std::string& text, int row) {
+        auto label = Gtk::make_managed<Gtk::Label>(text);
+        label->set_halign(Gtk::Align::START);
+        grid.attach(*label, 0, row);
+    };
+
+    add_label("Field name", 0);
+    name_entry.set_text(info.field_name);
+    grid.attach(name_entry, 1, 0, 3, 1);
+
+    add_label("Dimensions", 1);
+    add_label("Spacing", 2);
+    add_label("Origin", 3);
+    int dims[3] = {info.nx, info.ny, info.nz};
+    for (int i = 0; i < 3; i++) {
+        dim_buttons[i].set_adjustment(Gtk::Adjustment::create(std::max(dims[i], 1), 1, 1 << 20, 1, 64));
+        dim_buttons[i].set_digits(0);
+        grid.attach(dim_buttons[i], i + 1, 1);
+
+        spacing_buttons[i].set_adjustment(Gtk::Adjustment::create(info.spacing[i], 1e-6, 1e6, 0.01, 1.0));
+        spacing_buttons[i].set_digits(4);
+        grid.attach(spacing_buttons[i], i + 1, 2);
+
+        origin_buttons[i].set_adjustment(Gtk::Adjustment::create(info.origin[i], -1e9, 1e9, 0.1, 10.0));
+        origin_buttons[i].set_digits(4);
+        grid.attach(origin_buttons[i], i + 1, 3);
+    }
+
+    // Same order as MVF::RawType
+    add_label("Data type", 4);
+    for (auto type : {"uint8", "uint16", "int16", "float32", "float64"}) {
+        type_menu.append(type);
+    }
+    type_menu.set_active(static_cast<int>(info.type));
+    grid.attach(type_menu, 1, 4);
+    big_endian_check.set_active(info.big_endian);
+    grid.attach(big_endian_check, 2, 4, 2, 1);
+
+    add_label("Header bytes", 5);
+    header_button.set_adjustment(Gtk::Adjustment::create(info.header_bytes, 0, 1 << 30, 1, 512));
+    header_button.set_digits(0);
+    grid.attach(header_button, 1, 5);
+
+    button_box.set_halign(Gtk::Align::END);
+    button_box.append(cancel_button);
+    button_box.append(import_button);
+    cancel_button.signal_clicked().connect([this] () {
+        set_visible(false);
+    });
+    import_button.signal_clicked().connect(sigc::mem_fun(*this, &RawImportDialog::on_import));
+
+    vbox.set_margin(10);
+    vbox.append(grid);
+    vbox.append(button_box);
+    set_child(vbox);
+}
+
+void RawImportDialog::on_import() {
+    MVF::RawVolumeInfo info;
+    info.field_name = name_entry.get_text().raw();
+    info.nx = dim_buttons[0].get_value_as_int();
+    info.ny = dim_buttons[1].get_value_as_int();
+    info.nz = dim_buttons[2].get_value_as_int();
+    info.spacing = Vector3f(spacing_buttons[0].get_value(), spacing_buttons[1].get_value(), spacing_buttons[2].get_value());
+    info.origin = Vector3f(origin_buttons[0].get_value(), origin_buttons[1].get_value(), origin_buttons[2].get_value());
+    info.type = static_cast<MVF::RawType>(std::max(type_menu.get_active_row_number(), 0));
+    info.big_endian = big_endian_check.get_active();
+    info.header_bytes = static_cast<size_t>(header_button.get_value());
+
+    set_visible(false);
+    on_accept(info);
+}
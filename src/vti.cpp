@@ -0,0 +1,703 @@
+#include <iostream>
+#include <sstream>
+#include <charconv>
+#include <cctype>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <bit>
+#include <zlib.h>
+#include "vtk.h"
+#include "mapped_file.h"
+#include "field_cache.h"
+#include "parallel.h"
+
+// Number of values converted between progress updates/cancellation checks
+constexpr size_t VTI_CHUNK_VALUES = 1 << 20;
+
+namespace MVF {
+    enum class VtiFormat {
+        ASCII,
+        BINARY,
+        APPENDED
+    };
+
+    // Converts count values starting at value index first of an array into its component arrays
+    using ScatterFn = void (*)(const char* src, size_t first, size_t count, const std::vector<void*>& dests);
+
+    struct VtiArray {
+        std::string name;
+        std::string type;
+        size_t comps = 1;
+        VtiFormat format = VtiFormat::APPENDED;
+        size_t offset = 0;
+        const char* text_begin = nullptr; // Element content for inline arrays
+        const char* text_end = nullptr;
+    };
+
+    struct VtiInfo {
+        int nx = 0, ny = 0, nz = 0;
+        Vector3f origin = Vector3f(0.0f);
+        Vector3f spacing = Vector3f(1.0f);
+        bool big_endian = false;
+        size_t header_size = 4;
+        bool compressed = false;
+        bool appended_raw = true;
+        const char* appended = nullptr;
+        std::vector<VtiArray> arrays;
+    };
+
+    struct XmlTag {
+        std::string name;
+        std::unordered_map<std::string, std::string> attrs;
+        bool closing = false;
+        bool self_closing = false;
+    };
+
+    // Reads the next tag, skipping text, comments and processing instructions. ptr is left after the tag.
+    static bool next_tag(const char*& ptr, const char* end, XmlTag& tag) {
+        while (true) {
+            ptr = static_cast<const char*>(std::memchr(ptr, '<', end - ptr));
+            if (!ptr) {
+                return false;
+            }
+
+            if (end - ptr >= 4 && std::memcmp(ptr, "<!--", 4) == 0) {
+                auto close = std::string_view(ptr, end - ptr).find("-->");
+                if (close == std::string_view::npos) return false;
+                ptr += close + 3;
+                continue;
+            }
+
+            if (end - ptr >= 2 && (ptr[1] == '?' || ptr[1] == '!')) {
+                ptr = static_cast<const char*>(std::memchr(ptr, '>', end - ptr));
+                if (!ptr) return false;
+                ++ptr;
+                continue;
+            }
+
+            break;
+        }
+
+        ++ptr;
+        tag = XmlTag{};
+        if (ptr < end && *ptr == '/') {
+            tag.closing = true;
+            ++ptr;
+        }
+
+        auto is_name_char = [] (char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':' || c == '-' || c == '.';
+        };
+        auto skip_blank = [&ptr, end] {
+            while (ptr < end && std::isspace(static_cast<unsigned char>(*ptr))) ++ptr;
+        };
+
+        const char* name_begin = ptr;
+        while (ptr < end && is_name_char(*ptr)) ++ptr;
+        tag.name.assign(name_begin, ptr);
+
+        while (true) {
+            skip_blank();
+            if (ptr >= end) {
+                return false;
+            }
+            if (*ptr == '>') {
+                ++ptr;
+                return true;
+            }
+            if (*ptr == '/') {
+                tag.self_closing = true;
+                ++ptr;
+                continue;
+            }
+
+            const char* key_begin = ptr;
+            while (ptr < end && is_name_char(*ptr)) ++ptr;
+            std::string key(key_begin, ptr);
+            skip_blank();
+            if (key.empty() || ptr >= end || *ptr != '=') {
+                return false;
+            }
+            ++ptr;
+            skip_blank();
+            if (ptr >= end || (*ptr != '"' && *ptr != '\'')) {
+                return false;
+            }
+
+            char quote = *ptr++;
+            const char* value_begin = ptr;
+            ptr = static_cast<const char*>(std::memchr(ptr, quote, end - ptr));
+            if (!ptr) {
+                return false;
+            }
+            tag.attrs[key] = std::string(value_begin, ptr);
+            ++ptr;
+        }
+    }
+
+    template <typename T, bool swap>
+    static T load_value(const char* src) {
+        if constexpr (sizeof(T) == 1) {
+            return static_cast<T>(*src);
+        }
+        else {
+            using Bits = std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+            Bits bits;
+            std::memcpy(&bits, src, sizeof(T));
+            if constexpr (swap) {
+                bits = std::byteswap(bits);
+            }
+            return std::bit_cast<T>(bits);
+        }
+    }
+
+    template <typename T, typename D, bool swap>
+    static void scatter_values(const char* src, size_t first, size_t count, const std::vector<void*>& dests) {
+        size_t comps = dests.size();
+        if (comps == 1) {
+            auto dest = static_cast<D*>(dests[0]) + first;
+            for (size_t i = 0; i < count; i++) {
+                dest[i] = static_cast<D>(load_value<T, swap>(src + i * sizeof(T)));
+            }
+            return;
+        }
+
+        size_t comp = first % comps, tuple = first / comps;
+        for (size_t i = 0; i < count; i++) {
+            static_cast<D*>(dests[comp])[tuple] = static_cast<D>(load_value<T, swap>(src + i * sizeof(T)));
+            if (++comp == comps) {
+                comp = 0;
+                tuple++;
+            }
+        }
+    }
+
+    template <typename T, typename D = float>
+    static ScatterFn get_scatter(bool big_endian) {
+        constexpr bool native_big = std::endian::native == std::endian::big;
+        return big_endian == native_big ? scatter_values<T, D, false> : scatter_values<T, D, true>;
+    }
+
+    // Returns the element size of a VTK XML type name along with its converter and the type the field
+    // is stored as. 8 and 16 bit integers are kept as they are, the rest become floats.
+    static size_t get_vti_converter(const std::string& type, bool big_endian, ScatterFn& scatter, FieldType& storage) {
+        storage = FieldType::FLOAT32;
+        if (type == "Float32") { scatter = get_scatter<float>(big_endian); return 4; }
+        if (type == "Float64") { scatter = get_scatter<double>(big_endian); return 8; }
+        if (type == "Int8") { scatter = get_scatter<int8_t, int8_t>(big_endian); storage = FieldType::INT8; return 1; }
+        if (type == "UInt8") { scatter = get_scatter<uint8_t, uint8_t>(big_endian); storage = FieldType::UINT8; return 1; }
+        if (type == "Int16") { scatter = get_scatter<int16_t, int16_t>(big_endian); storage = FieldType::INT16; return 2; }
+        if (type == "UInt16") { scatter = get_scatter<uint16_t, uint16_t>(big_endian); storage = FieldType::UINT16; return 2; }
+        if (type == "Int32") { scatter = get_scatter<int32_t>(big_endian); return 4; }
+        if (type == "UInt32") { scatter = get_scatter<uint32_t>(big_endian); return 4; }
+        if (type == "Int64") { scatter = get_scatter<int64_t>(big_endian); return 8; }
+        if (type == "UInt64") { scatter = get_scatter<uint64_t>(big_endian); return 8; }
+
+        return 0;
+    }
+
+    static bool parse_vti_header(const char* ptr, const char* end, VtiInfo& info) {
+        XmlTag tag;
+        bool in_point_data = false;
+        bool has_extent = false;
+
+        auto parse_floats = [] (const std::string& text, float* out, size_t count) {
+            std::istringstream ss(text);
+            for (size_t i = 0; i < count; i++) {
+                if (!(ss >> out[i])) return false;
+            }
+            return true;
+        };
+
+        // The whole attribute has to be a number, a missing one is empty and fails too
+        auto parse_count = [] (const std::string& text, size_t& out) {
+            auto [next, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+            return ec == std::errc() && next == text.data() + text.size();
+        };
+
+        while (next_tag(ptr, end, tag)) {
+            if (tag.name == "VTKFile" && !tag.closing) {
+                if (tag.attrs["type"] != "ImageData") {
+                    std::cerr << "Only ImageData XML files are supported" << std::endl;
+                    return false;
+                }
+                info.big_endian = tag.attrs["byte_order"] == "BigEndian";
+                info.header_size = tag.attrs["header_type"] == "UInt64" ? 8 : 4;
+                if (tag.attrs.contains("compressor")) {
+                    if (tag.attrs["compressor"] != "vtkZLibDataCompressor") {
+                        std::cerr << "Unsupported compressor " << tag.attrs["compressor"] << std::endl;
+                        return false;
+                    }
+                    info.compressed = true;
+                }
+            }
+            else if (tag.name == "ImageData" && !tag.closing) {
+                int extent[6];
+                std::istringstream ss(tag.attrs["WholeExtent"]);
+                for (auto& e : extent) {
+                    if (!(ss >> e)) {
+                        std::cerr << "Invalid WholeExtent" << std::endl;
+                        return false;
+                    }
+                }
+                info.nx = extent[1] - extent[0] + 1;
+                info.ny = extent[3] - extent[2] + 1;
+                info.nz = extent[5] - extent[4] + 1;
+                has_extent = true;
+
+                if (tag.attrs.contains("Origin") && !parse_floats(tag.attrs["Origin"], &info.origin.x, 3)) {
+                    return false;
+                }
+                if (tag.attrs.contains("Spacing") && !parse_floats(tag.attrs["Spacing"], &info.spacing.x, 3)) {
+                    return false;
+                }
+            }
+            else if (tag.name == "Piece" && !tag.closing && !info.arrays.empty()) {
+                std::cerr << "Multi-piece ImageData files are not supported" << std::endl;
+                return false;
+            }
+            else if (tag.name == "PointData") {
+                in_point_data = !tag.closing && !tag.self_closing;
+            }
+            else if (tag.name == "DataArray" && !tag.closing && in_point_data) {
+                VtiArray array;
+                array.name = tag.attrs["Name"];
+                array.type = tag.attrs["type"];
+                if (tag.attrs.contains("NumberOfComponents") &&
+                    !parse_count(tag.attrs["NumberOfComponents"], array.comps)) {
+                    std::cerr << "Invalid NumberOfComponents of DataArray " << array.name << std::endl;
+                    return false;
+                }
+
+                auto& format = tag.attrs["format"];
+                if (format == "ascii") {
+                    array.format = VtiFormat::ASCII;
+                }
+                else if (format == "binary") {
+                    array.format = VtiFormat::BINARY;
+                }
+                else if (format == "appended") {
+                    array.format = VtiFormat::APPENDED;
+                    if (!parse_count(tag.attrs["offset"], array.offset)) {
+                        std::cerr << "Invalid offset of DataArray " << array.name << std::endl;
+                        return false;
+                    }
+                }
+                else {
+                    std::cerr << "Unsupported DataArray format " << format << std::endl;
+                    return false;
+                }
+
+                if (array.format != VtiFormat::APPENDED && !tag.self_closing) {
+                    array.text_begin = ptr;
+                    auto close = std::string_view(ptr, end - ptr).find("</DataArray");
+                    if (close == std::string_view::npos) {
+                        return false;
+                    }
+                    array.text_end = ptr + close;
+                    ptr = array.text_end;
+                }
+
+                info.arrays.push_back(array);
+            }
+            else if (tag.name == "AppendedData" && !tag.closing) {
+                info.appended_raw = tag.attrs["encoding"] != "base64";
+                // Appended data starts after an underscore, the binary blob must not be scanned for tags
+                ptr = static_cast<const char*>(std::memchr(ptr, '_', end - ptr));
+                if (!ptr) {
+                    return false;
+                }
+                info.appended = ptr + 1;
+                break;
+            }
+        }
+
+        if (!has_extent || info.nx <= 0 || info.ny <= 0 || info.nz <= 0) {
+            std::cerr << "Missing ImageData extent" << std::endl;
+            return false;
+        }
+
+        for (auto& array : info.arrays) {
+            if (array.format == VtiFormat::APPENDED && !info.appended) {
+                std::cerr << "Missing AppendedData for " << array.name << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Base64 decoding one quartet at a time, which also copes with writers that pad the
+    // header and the payload separately
+    struct Base64Reader {
+        const char* ptr = nullptr;
+        const char* end = nullptr;
+        unsigned char pending[3] = {};
+        size_t num_pending = 0, pending_pos = 0;
+
+        static int decode_char(char c) {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+') return 62;
+            if (c == '/') return 63;
+            return -1;
+        }
+
+        bool read(char* out, size_t nbytes) {
+            while (nbytes) {
+                if (pending_pos < num_pending) {
+                    *out++ = pending[pending_pos++];
+                    nbytes--;
+                    continue;
+                }
+
+                char quartet[4];
+                size_t filled = 0;
+                while (filled < 4 && ptr < end) {
+                    char c = *ptr++;
+                    if (!std::isspace(static_cast<unsigned char>(c))) {
+                        quartet[filled++] = c;
+                    }
+                }
+                if (filled < 4) {
+                    return false;
+                }
+
+                int v[4];
+                for (int i = 0; i < 4; i++) {
+                    v[i] = quartet[i] == '=' ? 0 : decode_char(quartet[i]);
+                    if (v[i] < 0) return false;
+                }
+
+                pending[0] = (v[0] << 2) | (v[1] >> 4);
+                pending[1] = ((v[1] & 0xf) << 4) | (v[2] >> 2);
+                pending[2] = ((v[2] & 0x3) << 6) | v[3];
+                num_pending = quartet[2] == '=' ? 1 : quartet[3] == '=' ? 2 : 3;
+                pending_pos = 0;
+            }
+
+            return true;
+        }
+    };
+
+    // Source of the bytes of one array, either raw appended data or a base64 stream
+    struct VtiStream {
+        const char* raw = nullptr;
+        const char* raw_end = nullptr;
+        Base64Reader base64{};
+        bool is_base64 = false;
+
+        bool read(char* out, size_t nbytes) {
+            if (is_base64) {
+                return base64.read(out, nbytes);
+            }
+            if (static_cast<size_t>(raw_end - raw) < nbytes) {
+                return false;
+            }
+            std::memcpy(out, raw, nbytes);
+            raw += nbytes;
+            return true;
+        }
+
+        // Direct access to the next nbytes, decoding them first when the stream is base64
+        const char* take(size_t nbytes, std::vector<char>& scratch) {
+            if (!is_base64) {
+                if (static_cast<size_t>(raw_end - raw) < nbytes) return nullptr;
+                auto ptr = raw;
+                raw += nbytes;
+                return ptr;
+            }
+            scratch.resize(nbytes);
+            return base64.read(scratch.data(), nbytes) ? scratch.data() : nullptr;
+        }
+    };
+
+    std::unique_ptr<LoadProxy> open_vti_async(const std::string& filename) {
+        auto proxy = std::make_unique<LoadProxy>();
+        proxy->read_failed = true;
+
+        // A previous load may have left the parsed fields next to the file
+        if (open_field_cache(filename, *proxy)) {
+            proxy->stats.finish_header();
+            return proxy;
+        }
+
+        MappedFile mapping;
+        VtiInfo info;
+        if (!mapping.open(filename) || !parse_vti_header(mapping.data(), mapping.data() + mapping.size(), info)) {
+            return proxy;
+        }
+
+        auto vol = std::make_shared<VolumeData>();
+        vol->filename = filename;
+        vol->nx = info.nx;
+        vol->ny = info.ny;
+        vol->nz = info.nz;
+        vol->origin = info.origin;
+        vol->spacing = info.spacing;
+
+        proxy->filename = filename;
+        proxy->data = vol;
+        proxy->format = VolumeFormat::VTI;
+        proxy->field_size = static_cast<size_t>(vol->nx) * vol->ny * vol->nz;
+        proxy->num_bytes_read = 0;
+        proxy->total_bytes = proxy->field_size * info.arrays.size();
+        proxy->total_fields_read = 0;
+        proxy->total_fields = info.arrays.size();
+        proxy->file_offset = 0;
+        proxy->read_failed = false;
+        proxy->thread_dispatched = false;
+        proxy->stop_requested = false;
+        proxy->load_finished = false;
+        proxy->stats.finish_header();
+
+        return proxy;
+    }
+
+    void LoadProxy::read_vti() {
+        try {
+            MappedFile mapping;
+            VtiInfo info;
+            {
+                PhaseTimer timer(stats, LoadPhase::HEADER);
+                if (!mapping.open(filename) || !parse_vti_header(mapping.data(), mapping.data() + mapping.size(), info)) {
+                    read_failed = true;
+                    return;
+                }
+            }
+
+            const char* file_end = mapping.data() + mapping.size();
+            for (auto& array : info.arrays) {
+                ScatterFn scatter = nullptr;
+                FieldType storage;
+                size_t type_size = get_vti_converter(array.type, info.big_endian, scatter, storage);
+                if (!type_size || array.comps == 0) {
+                    std::cerr << "Array " << array.name << " has unsupported type " << array.type << std::endl;
+                    read_failed = true;
+                    return;
+                }
+
+                size_t num_values = field_size * array.comps;
+
+                // Text arrays are parsed as floats whatever their declared type
+                if (array.format == VtiFormat::ASCII) {
+                    auto dests = add_field(array.name, array.comps);
+                    {
+                        PhaseTimer timer(stats, LoadPhase::READ);
+                        prefault(array.text_begin, array.text_end - array.text_begin);
+                        stats.add_bytes(array.text_end - array.text_begin);
+                    }
+
+                    PhaseTimer timer(stats, LoadPhase::PARSE);
+                    const char* ptr = array.text_begin;
+                    for (size_t i = 0; i < num_values; i++) {
+                        while (ptr < array.text_end && std::isspace(static_cast<unsigned char>(*ptr))) ++ptr;
+                        float v;
+                        auto [next, ec] = std::from_chars(ptr, array.text_end, v);
+                        if (ec != std::errc()) {
+                            std::cerr << "Invalid value in array " << array.name << std::endl;
+                            read_failed = true;
+                            return;
+                        }
+                        ptr = next;
+                        dests[i % array.comps][i / array.comps] = v;
+                    }
+                    report_values(num_values);
+                    total_fields_read++;
+                    continue;
+                }
+
+                auto dests = add_field(array.name, array.comps, storage);
+                VtiStream stream;
+                if (array.format == VtiFormat::BINARY) {
+                    stream.is_base64 = true;
+                    stream.base64 = Base64Reader{.ptr = array.text_begin, .end = array.text_end};
+                }
+                else if (info.appended_raw) {
+                    stream.raw = info.appended + array.offset;
+                    stream.raw_end = file_end;
+                    if (stream.raw > file_end) {
+                        read_failed = true;
+                        return;
+                    }
+                }
+                else {
+                    stream.is_base64 = true;
+                    stream.base64 = Base64Reader{.ptr = info.appended + array.offset, .end = file_end};
+                }
+
+                auto read_header_value = [&stream, &info] (uint64_t& value) {
+                    char bytes[8];
+                    if (!stream.read(bytes, info.header_size)) {
+                        return false;
+                    }
+                    value = info.header_size == 8 ? load_value<uint64_t, false>(bytes) : load_value<uint32_t, false>(bytes);
+                    if (info.big_endian != (std::endian::native == std::endian::big)) {
+                        value = info.header_size == 8 ? std::byteswap(value) : std::byteswap(static_cast<uint32_t>(value));
+                    }
+                    return true;
+                };
+
+                std::vector<char> scratch;
+                if (!info.compressed) {
+                    uint64_t num_bytes;
+                    if (!read_header_value(num_bytes) || num_bytes < num_values * type_size) {
+                        std::cerr << "Array " << array.name << " is truncated" << std::endl;
+                        read_failed = true;
+                        return;
+                    }
+
+                    // Base64 is decoded while taking the bytes, so that counts as reading
+                    const char* src = nullptr;
+                    {
+                        PhaseTimer timer(stats, LoadPhase::READ);
+                        src = stream.take(num_values * type_size, scratch);
+                        if (src) {
+                            prefault(src, num_values * type_size);
+                            stats.add_bytes(num_values * type_size);
+                        }
+                    }
+                    if (!src) {
+                        std::cerr << "Array " << array.name << " is truncated" << std::endl;
+                        read_failed = true;
+                        return;
+                    }
+
+                    size_t num_chunks = (num_values + VTI_CHUNK_VALUES - 1) / VTI_CHUNK_VALUES;
+                    parallel_for(num_chunks, [&] (size_t i) {
+                        if (stop_requested.load(std::memory_order_relaxed)) {
+                            return;
+                        }
+                        PhaseTimer timer(stats, LoadPhase::PARSE);
+                        size_t first = i * VTI_CHUNK_VALUES;
+                        size_t count = std::min(VTI_CHUNK_VALUES, num_values - first);
+                        scatter(src + first * type_size, first, count, dests);
+                        report_values(count);
+                    });
+                }
+                else {
+                    // Compressed arrays: [#blocks, block size, last block size, compressed sizes...] then the blocks
+                    uint64_t num_blocks, block_size, last_block_size;
+                    if (!read_header_value(num_blocks) || !read_header_value(block_size) || !read_header_value(last_block_size)) {
+                        read_failed = true;
+                        return;
+                    }
+
+                    std::vector<uint64_t> block_offsets(num_blocks + 1, 0);
+                    for (size_t b = 0; b < num_blocks; b++) {
+                        uint64_t compressed_size;
+                        if (!read_header_value(compressed_size)) {
+                            read_failed = true;
+                            return;
+                        }
+                        block_offsets[b + 1] = block_offsets[b] + compressed_size;
+                    }
+
+                    auto uncompressed_size = [&] (size_t b) {
+                        return b + 1 == num_blocks && last_block_size ? last_block_size : block_size;
+                    };
+
+                    // Every block is inflated into room for block_size bytes, so the last one cannot be any larger
+                    if ((num_blocks > 0 && block_size == 0) || last_block_size > block_size) {
+                        std::cerr << "Invalid block sizes in array " << array.name << std::endl;
+                        read_failed = true;
+                        return;
+                    }
+
+                    uint64_t total_uncompressed = num_blocks ? (num_blocks - 1) * block_size + uncompressed_size(num_blocks - 1) : 0;
+                    if (total_uncompressed < num_values * type_size) {
+                        std::cerr << "Array " << array.name << " is truncated" << std::endl;
+                        read_failed = true;
+                        return;
+                    }
+
+                    const char* compressed = nullptr;
+                    {
+                        PhaseTimer timer(stats, LoadPhase::READ);
+                        compressed = stream.take(block_offsets[num_blocks], scratch);
+                        if (compressed) {
+                            prefault(compressed, block_offsets[num_blocks]);
+                            stats.add_bytes(block_offsets[num_blocks]);
+                        }
+                    }
+                    if (!compressed) {
+                        std::cerr << "Array " << array.name << " is truncated" << std::endl;
+                        read_failed = true;
+                        return;
+                    }
+
+                    // Blocks are independent zlib streams. When blocks hold whole values each one is inflated and
+                    // converted on its own, otherwise they are inflated side by side into one buffer first.
+                    bool blocks_aligned = block_size % type_size == 0;
+                    std::vector<char> inflated;
+                    if (!blocks_aligned) {
+                        inflated.resize(total_uncompressed);
+                    }
+
+                    std::atomic<bool> inflate_failed = false;
+                    parallel_for(num_blocks, [&] (size_t b) {
+                        if (inflate_failed.load(std::memory_order_relaxed) || stop_requested.load(std::memory_order_relaxed)) {
+                            return;
+                        }
+
+                        PhaseTimer timer(stats, LoadPhase::PARSE);
+                        thread_local std::vector<char> block;
+                        char* dest = inflated.data() + b * block_size;
+                        if (blocks_aligned) {
+                            block.resize(uncompressed_size(b));
+                            dest = block.data();
+                        }
+
+                        uLongf dest_len = uncompressed_size(b);
+                        auto res = uncompress(reinterpret_cast<Bytef*>(dest), &dest_len,
+                            reinterpret_cast<const Bytef*>(compressed + block_offsets[b]), block_offsets[b + 1] - block_offsets[b]);
+                        if (res != Z_OK || dest_len != uncompressed_size(b)) {
+                            inflate_failed.store(true, std::memory_order_relaxed);
+                            return;
+                        }
+
+                        if (blocks_aligned) {
+                            size_t first = b * block_size / type_size;
+                            if (first < num_values) {
+                                size_t count = std::min<size_t>(dest_len / type_size, num_values - first);
+                                scatter(dest, first, count, dests);
+                                report_values(count);
+                            }
+                        }
+                    });
+
+                    if (inflate_failed.load(std::memory_order_relaxed)) {
+                        std::cerr << "Failed to decompress array " << array.name << std::endl;
+                        read_failed = true;
+                        return;
+                    }
+
+                    if (!blocks_aligned) {
+                        size_t num_chunks = (num_values + VTI_CHUNK_VALUES - 1) / VTI_CHUNK_VALUES;
+                        parallel_for(num_chunks, [&] (size_t i) {
+                            PhaseTimer timer(stats, LoadPhase::PARSE);
+                            size_t first = i * VTI_CHUNK_VALUES;
+                            size_t count = std::min(VTI_CHUNK_VALUES, num_values - first);
+                            scatter(inflated.data() + first * type_size, first, count, dests);
+                            report_values(count);
+                        });
+                    }
+                }
+
+                if (stop_requested.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                total_fields_read++;
+            }
+
+            PhaseTimer timer(stats, LoadPhase::FINALIZE);
+            load_finished.store(true, std::memory_order_release);
+            write_cache();
+        } catch (const std::exception& e) {
+            std::cerr << "Error while loading VTI file: " << e.what() << std::endl;
+            read_failed = true;
+        }
+    }
+}
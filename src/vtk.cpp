@@ -2,9 +2,61 @@
 #include <fstream>
 #include <sstream>
 #include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <bit>
+#include <future>
+#include <filesystem>
+#include <algorithm>
 #include "vtk.h"
+#include "mapped_file.h"
+#include "field_cache.h"
+#include "parallel.h"
 #include "error.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MVF_X86_SIMD
+#endif
+
+// Number of values converted between progress updates/cancellation checks
+constexpr size_t BINARY_CHUNK_VALUES = 1 << 20;
+
+// ASCII field data is streamed in blocks of this size (two are in flight at once)
+constexpr size_t ASCII_BLOCK_BYTES = 1 << 23;
+// Target size of the slices a block is split into for parallel parsing
+constexpr size_t ASCII_CHUNK_BYTES = 1 << 18;
+
+namespace MVF {
+    struct AsciiField {
+        size_t start; // Index of the field's first value in the stream of all field values
+        size_t size;
+        size_t comps;
+        std::vector<float*> dests; // One array per component
+    };
+
+    struct AsciiParseState {
+        std::vector<AsciiField> fields;
+        size_t values_seen = 0;
+    };
+
+    // A field header line found while scanning, values_before counts the values preceding it in its chunk
+    struct AsciiHeader {
+        size_t values_before;
+        const char* begin;
+        const char* end;
+    };
+
+    struct AsciiChunk {
+        const char* begin;
+        const char* end;
+        size_t num_values = 0;
+        std::vector<AsciiHeader> headers;
+        size_t first_value = 0;
+        size_t first_field = 0;
+    };
+}
+
 namespace MVF {
     bool read_file(const std::string& filename, std::string& out) {
         std::ifstream file(filename, std::ios::in | std::ios::binary);
@@ -20,6 +72,417 @@ namespace MVF {
         return true;
     }
     
+    // Legacy binary VTK stores every value in big-endian order. The 4-byte swap is the hot path
+    // (float fields), so it gets shuffle based kernels on x86 picked at runtime.
+#ifdef MVF_X86_SIMD
+    __attribute__((target("avx2")))
+    static size_t byteswap32_avx2(const char* src, char* dst, size_t count) {
+        const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(v, mask));
+        }
+        return i;
+    }
+
+    __attribute__((target("ssse3")))
+    static size_t byteswap32_ssse3(const char* src, char* dst, size_t count) {
+        const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_shuffle_epi8(v, mask));
+        }
+        return i;
+    }
+#endif
+
+    static void byteswap32(const char* src, char* dst, size_t count) {
+        size_t i = 0;
+#ifdef MVF_X86_SIMD
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+        if (has_avx2) {
+            i = byteswap32_avx2(src, dst, count);
+        }
+        else if (has_ssse3) {
+            i = byteswap32_ssse3(src, dst, count);
+        }
+#endif
+        for (; i < count; i++) {
+            uint32_t v;
+            std::memcpy(&v, src + i * 4, 4);
+            v = __builtin_bswap32(v);
+            std::memcpy(dst + i * 4, &v, 4);
+        }
+    }
+
+    template <typename T>
+    static T load_big_endian(const char* src) {
+        if constexpr (sizeof(T) == 1) {
+            return static_cast<T>(*src);
+        }
+        else if constexpr (sizeof(T) == 2) {
+            uint16_t v;
+            std::memcpy(&v, src, 2);
+            v = __builtin_bswap16(v);
+            return std::bit_cast<T>(v);
+        }
+        else if constexpr (sizeof(T) == 4) {
+            uint32_t v;
+            std::memcpy(&v, src, 4);
+            v = __builtin_bswap32(v);
+            return std::bit_cast<T>(v);
+        }
+        else {
+            uint64_t v;
+            std::memcpy(&v, src, 8);
+            v = __builtin_bswap64(v);
+            return std::bit_cast<T>(v);
+        }
+    }
+
+    template <typename T, typename D>
+    static void convert_big_endian(const char* src, void* dst, size_t count) {
+        if constexpr (std::is_same_v<T, float> && std::is_same_v<D, float>) {
+            byteswap32(src, static_cast<char*>(dst), count);
+        }
+        else {
+            auto out = static_cast<D*>(dst);
+            for (size_t i = 0; i < count; i++) {
+                out[i] = static_cast<D>(load_big_endian<T>(src + i * sizeof(T)));
+            }
+        }
+    }
+
+    using BinaryConverter = void (*)(const char*, void*, size_t);
+
+    // Returns the element size of a legacy VTK data type name along with its converter and the type
+    // the field is stored as. 8 and 16 bit integers are kept as they are, the rest become floats.
+    static size_t get_binary_converter(const std::string& type, BinaryConverter& convert, FieldType& storage) {
+        storage = FieldType::FLOAT32;
+        if (type == "float") {
+            convert = convert_big_endian<float, float>;
+            return 4;
+        }
+        if (type == "double") {
+            convert = convert_big_endian<double, float>;
+            return 8;
+        }
+        if (type == "unsigned_char") {
+            convert = convert_big_endian<uint8_t, uint8_t>;
+            storage = FieldType::UINT8;
+            return 1;
+        }
+        if (type == "char") {
+            convert = convert_big_endian<int8_t, int8_t>;
+            storage = FieldType::INT8;
+            return 1;
+        }
+        if (type == "unsigned_short") {
+            convert = convert_big_endian<uint16_t, uint16_t>;
+            storage = FieldType::UINT16;
+            return 2;
+        }
+        if (type == "short") {
+            convert = convert_big_endian<int16_t, int16_t>;
+            storage = FieldType::INT16;
+            return 2;
+        }
+        if (type == "unsigned_int") {
+            convert = convert_big_endian<uint32_t, float>;
+            return 4;
+        }
+        if (type == "int") {
+            convert = convert_big_endian<int32_t, float>;
+            return 4;
+        }
+        if (type == "vtktypeuint64") {
+            convert = convert_big_endian<uint64_t, float>;
+            return 8;
+        }
+        if (type == "vtktypeint64") {
+            convert = convert_big_endian<int64_t, float>;
+            return 8;
+        }
+
+        return 0;
+    }
+
+    // Splits count interleaved tuples into the component arrays, starting at tuple offset
+    static void split_components(const void* tuples, size_t elem_size, size_t offset, size_t count, const std::vector<void*>& dests) {
+        auto split = [&] <typename T> () {
+            auto src = static_cast<const T*>(tuples);
+            size_t comps = dests.size();
+            for (size_t i = 0; i < count; i++) {
+                for (size_t comp = 0; comp < comps; comp++) {
+                    static_cast<T*>(dests[comp])[offset + i] = src[i * comps + comp];
+                }
+            }
+        };
+
+        switch (elem_size) {
+            case 1: split.template operator()<uint8_t>(); break;
+            case 2: split.template operator()<uint16_t>(); break;
+            default: split.template operator()<float>(); break;
+        }
+    }
+
+    static bool is_blank(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    // A line is a field header ("name comps count type") if its first token is not a number. Names such as nan
+    // or inf read as numbers too, so a line starting with a word is only data when it is not shaped like a header.
+    static bool is_header_line(const char* ptr, const char* line_end) {
+        auto token_end = [line_end] (const char* p) {
+            while (p < line_end && !is_blank(*p)) ++p;
+            return p;
+        };
+        auto next_token = [line_end] (const char* p) {
+            while (p < line_end && is_blank(*p)) ++p;
+            return p;
+        };
+
+        const char* end = token_end(ptr);
+        float v;
+        auto [next, ec] = std::from_chars(ptr, end, v);
+        if (ec != std::errc() || next != end) {
+            return true;
+        }
+        if ((*ptr >= '0' && *ptr <= '9') || *ptr == '-' || *ptr == '.') {
+            return false;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            ptr = next_token(end);
+            end = token_end(ptr);
+            size_t count;
+            auto [count_end, count_ec] = std::from_chars(ptr, end, count);
+            if (count_ec != std::errc() || count_end != end) {
+                return false;
+            }
+        }
+
+        ptr = next_token(end);
+        end = token_end(ptr);
+        auto [type_end, type_ec] = std::from_chars(ptr, end, v);
+        return ptr != end && (type_ec != std::errc() || type_end != end) && next_token(end) == line_end;
+    }
+
+    static const char* next_line(const char* ptr, const char* end) {
+        auto line_end = static_cast<const char*>(std::memchr(ptr, '\n', end - ptr));
+        return line_end ? line_end : end;
+    }
+
+    // Pass 1: count the values in a chunk and note where the field headers sit
+    static void scan_ascii_chunk(AsciiChunk& chunk) {
+        const char* ptr = chunk.begin;
+        while (ptr < chunk.end) {
+            while (ptr < chunk.end && is_blank(*ptr)) ++ptr;
+            if (ptr >= chunk.end) break;
+
+            const char* line_end = next_line(ptr, chunk.end);
+            if (is_header_line(ptr, line_end)) {
+                chunk.headers.push_back({chunk.num_values, ptr, line_end});
+            }
+            else {
+                bool in_token = false;
+                for (; ptr < line_end; ++ptr) {
+                    bool blank = is_blank(*ptr);
+                    chunk.num_values += !blank && !in_token;
+                    in_token = !blank;
+                }
+            }
+            ptr = line_end;
+        }
+    }
+
+    // Pass 2: parse the chunk straight into the field arrays
+    static bool parse_ascii_chunk(const AsciiChunk& chunk, AsciiParseState& state, size_t& values_written) {
+        auto& fields = state.fields;
+        size_t global_idx = chunk.first_value;
+        size_t field_idx = chunk.first_field;
+        size_t comp = 0, tuple = 0;
+        bool cursor_valid = false;
+
+        const char* ptr = chunk.begin;
+        while (ptr < chunk.end) {
+            while (ptr < chunk.end && is_blank(*ptr)) ++ptr;
+            if (ptr >= chunk.end) break;
+
+            const char* line_end = next_line(ptr, chunk.end);
+            if (is_header_line(ptr, line_end)) {
+                ptr = line_end;
+                continue;
+            }
+
+            while (ptr < line_end) {
+                while (ptr < line_end && is_blank(*ptr)) ++ptr;
+                if (ptr >= line_end) break;
+
+                float v;
+                auto [next, ec] = std::from_chars(ptr, line_end, v);
+                if (ec != std::errc()) {
+                    std::cerr << "Invalid value in field data: " << std::string(ptr, std::min(next_line(ptr, line_end), ptr + 32)) << std::endl;
+                    return false;
+                }
+                ptr = next;
+
+                while (field_idx < fields.size() && global_idx >= fields[field_idx].start + fields[field_idx].size) {
+                    field_idx++;
+                    cursor_valid = false;
+                }
+                // Anything past the last field (trailing metadata) is ignored
+                if (field_idx < fields.size()) {
+                    auto& field = fields[field_idx];
+                    if (!cursor_valid) {
+                        auto local_idx = global_idx - field.start;
+                        comp = local_idx % field.comps;
+                        tuple = local_idx / field.comps;
+                        cursor_valid = true;
+                    }
+
+                    // Interleaved tuples are split into their component arrays as they are parsed
+                    field.dests[comp][tuple] = v;
+                    if (++comp == field.comps) {
+                        comp = 0;
+                        tuple++;
+                    }
+                    values_written++;
+                }
+                global_idx++;
+            }
+        }
+
+        return true;
+    }
+
+    // Splits a run of complete lines into newline aligned chunks and scans them in parallel. Blocks come one
+    // after another, so the workers of pool are reused across them rather than started for each.
+    static std::vector<AsciiChunk> scan_ascii_block(WorkerPool& pool, const char* begin, const char* end) {
+        std::vector<AsciiChunk> chunks;
+        for (const char* ptr = begin; ptr < end;) {
+            const char* chunk_end = ptr + std::min<size_t>(ASCII_CHUNK_BYTES, end - ptr);
+            if (chunk_end < end) {
+                chunk_end = next_line(chunk_end, end);
+                chunk_end += (chunk_end < end);
+            }
+            chunks.push_back(AsciiChunk{.begin = ptr, .end = chunk_end});
+            ptr = chunk_end;
+        }
+
+        pool.run(chunks.size(), [&chunks](size_t i) {
+            scan_ascii_chunk(chunks[i]);
+        });
+
+        return chunks;
+    }
+
+    // Parses a run of complete lines holding field values. The chunks are scanned in parallel, placed in
+    // the value stream in order, then parsed in parallel.
+    static bool parse_ascii_block(LoadProxy& proxy, WorkerPool& pool, AsciiParseState& state, const char* begin,
+        const char* end) {
+        PhaseTimer timer(proxy.stats, LoadPhase::PARSE);
+        auto chunks = scan_ascii_block(pool, begin, end);
+        for (auto& chunk : chunks) {
+            // Byte ranges come from the index, so they never span a header
+            if (!chunk.headers.empty()) {
+                std::cerr << "Unexpected header in field data: " << std::string(chunk.headers[0].begin, chunk.headers[0].end) << std::endl;
+                return false;
+            }
+
+            chunk.first_value = state.values_seen;
+            chunk.first_field = 0;
+            state.values_seen += chunk.num_values;
+        }
+
+        std::atomic<bool> parse_failed = false;
+        pool.run(chunks.size(), [&](size_t i) {
+            if (parse_failed.load(std::memory_order_relaxed) || proxy.stop_requested.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            size_t values_written = 0;
+            if (!parse_ascii_chunk(chunks[i], state, values_written)) {
+                parse_failed.store(true, std::memory_order_relaxed);
+            }
+            proxy.report_values(values_written);
+        });
+
+        return !parse_failed.load(std::memory_order_relaxed);
+    }
+
+    // Streams the bytes [begin, end) of a file in fixed size blocks. While one block is processed, the next
+    // one is read in the background into the other buffer. A partial line at the end of a block is carried
+    // over to the front of the next buffer, so on_block(ptr, end, file position of ptr) always sees whole
+    // lines. Streaming stops early when on_block returns false.
+    template <typename F>
+    static void stream_ascii_lines(std::ifstream& file, LoadStats& stats, size_t begin, size_t end, F&& on_block) {
+        file.clear();
+        file.seekg(begin, std::ios::beg);
+
+        std::array<std::vector<char>, 2> buffers;
+        buffers[0].resize(ASCII_BLOCK_BYTES);
+        buffers[1].resize(ASCII_BLOCK_BYTES);
+
+        size_t remaining = end - begin;
+        bool exhausted = false;
+        auto read_block = [&file, &stats, &remaining, &exhausted](std::vector<char>& buffer, size_t offset) {
+            PhaseTimer timer(stats, LoadPhase::READ);
+            size_t size = std::min(ASCII_BLOCK_BYTES, remaining);
+            if (buffer.size() < offset + size) {
+                buffer.resize(offset + size);
+            }
+            file.read(buffer.data() + offset, size);
+            size_t read = static_cast<size_t>(file.gcount());
+            stats.add_bytes(read);
+            remaining -= read;
+            exhausted = remaining == 0 || read < size;
+            return offset + read;
+        };
+
+        size_t pos = begin;
+        size_t cur = 0;
+        size_t cur_size = read_block(buffers[cur], 0);
+        bool eof = exhausted;
+
+        while (cur_size) {
+            auto& buffer = buffers[cur];
+            auto& next_buffer = buffers[cur ^ 1];
+
+            // Everything up to the last newline is handled now, the rest waits for the next block
+            size_t parse_size = cur_size;
+            if (!eof) {
+                while (parse_size > 0 && buffer[parse_size - 1] != '\n') --parse_size;
+            }
+
+            size_t carry = cur_size - parse_size;
+            if (next_buffer.size() < carry) {
+                next_buffer.resize(carry);
+            }
+            std::memcpy(next_buffer.data(), buffer.data() + parse_size, carry);
+
+            std::future<size_t> next_read;
+            if (!eof) {
+                next_read = std::async(std::launch::async, read_block, std::ref(next_buffer), carry);
+            }
+
+            bool keep_going = on_block(buffer.data(), buffer.data() + parse_size, pos);
+            size_t next_size = next_read.valid() ? next_read.get() : 0;
+            if (!keep_going) {
+                return;
+            }
+
+            pos += parse_size;
+            eof = eof || exhausted;
+            cur_size = next_size;
+            cur ^= 1;
+        }
+    }
+
     VolumeData::~VolumeData() {
 #ifdef MVF_DEBUG
         std::cout << "Destroyed model object: " << filename << std::endl;
@@ -38,10 +501,17 @@ namespace MVF {
             return proxy;
         }
 
+        // A previous load may have left the parsed fields next to the file
+        if (open_field_cache(filename, *proxy)) {
+            proxy->stats.finish_header();
+            return proxy;
+        }
+
         std::array<std::string, 4> header = {"# vtk DataFile Version 5.1", "vtk output", "ASCII", 
                     "DATASET STRUCTURED_POINTS"};
         
         size_t header_idx = 0;
+        bool is_binary = false;
         std::string line, tag;
         auto clean_line = [&](std::string& s) {
             if (!s.empty() && s.back() == '\r')
@@ -57,7 +527,11 @@ namespace MVF {
             }
 
             clean_line(line);
-            if (line != header[header_idx]) {
+            // Legacy files can carry their fields either as text or as big-endian binary
+            if (header_idx == 2 && line == "BINARY") {
+                is_binary = true;
+            }
+            else if (line != header[header_idx]) {
     #ifdef MVF_DEBUG
                 std::cerr << "Expected line: " << header[header_idx] << std::endl;
     #endif
@@ -156,13 +630,82 @@ namespace MVF {
         proxy->total_fields_read = 0;
         proxy->total_fields = total_fields;
         proxy->field_size = (size_t)(vol->nx * vol->ny * vol->nz);
+        proxy->format = is_binary ? VolumeFormat::VTK_BINARY : VolumeFormat::VTK_ASCII;
         proxy->read_failed = false;
         proxy->thread_dispatched = false;
         proxy->stop_requested = false;
+        proxy->load_finished = false;
+        proxy->stats.finish_header();
 
         return proxy;
     }
 
+    std::unique_ptr<LoadProxy> open_volume_async(const std::string& filename) {
+        auto ext = std::filesystem::path(filename).extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [] (unsigned char c) { return std::tolower(c); });
+        if (ext == ".vti") {
+            return open_vti_async(filename);
+        }
+
+        if (ext == ".raw") {
+            RawVolumeInfo info;
+            if (!guess_raw_info(filename, info)) {
+                std::cerr << "Unable to infer the layout of " << filename << std::endl;
+                auto proxy = std::make_unique<LoadProxy>();
+                proxy->read_failed = true;
+                return proxy;
+            }
+            return open_raw_async(filename, info);
+        }
+
+        return open_vtk_async(filename);
+    }
+
+    static std::string component_name(const std::string& name, size_t comp, size_t comps) {
+        if (comps <= 3) {
+            return name + "_" + "XYZ"[comp];
+        }
+        return name + "_" + std::to_string(comp);
+    }
+
+    std::vector<float*> LoadProxy::add_field(const std::string& name, size_t comps) {
+        std::vector<float*> dests;
+        for (auto dest : add_field(name, comps, FieldType::FLOAT32)) {
+            dests.push_back(static_cast<float*>(dest));
+        }
+        return dests;
+    }
+
+    std::vector<void*> LoadProxy::add_field(const std::string& name, size_t comps, FieldType type) {
+        std::vector<void*> dests;
+        if (comps == 1) {
+            auto& dest = data->scalars[name];
+            dest = ScalarField(type, field_size);
+            dests.push_back(dest.data());
+            return dests;
+        }
+
+        // A group listed by the indexing pass may already be shown by the UI, so it is left untouched
+        auto& group = data->groups[name];
+        bool listed = group.size() == comps;
+        if (!listed) {
+            group.clear();
+        }
+        for (size_t comp = 0; comp < comps; comp++) {
+            auto comp_name = component_name(name, comp, comps);
+            auto& dest = data->scalars[comp_name];
+            dest = ScalarField(type, field_size);
+            dests.push_back(dest.data());
+            if (!listed) {
+                group.push_back(comp_name);
+            }
+        }
+
+        // Progress is counted in values, so the extra components add to the expected total
+        total_bytes += (comps - 1) * field_size;
+        return dests;
+    }
+
     bool LoadProxy::load() {
         // We're done
         if (total_fields_read == total_fields) {
@@ -175,82 +718,392 @@ namespace MVF {
         
         thread_dispatched.store(true, std::memory_order_release);
         worker_thread = std::thread([this] {
-            try {
-                // Read the entire file into memory at once
-                file.seekg(0, std::ios::end);
-                std::streamsize size = file.tellg() - file_offset;
-                file.seekg(file_offset, std::ios::beg);
-
-                std::string buffer(size, '\0');
-                file.read(buffer.data(), size);
-                file.close();
-
-                const char* ptr = buffer.data();
-                const char* end = ptr + buffer.size();
-
-                size_t cur_field_idx = 0;
-                std::string cur_tag;
-
-                while (total_fields_read < total_fields && ptr < end) {
-                    if (cur_field_idx == 0) {
-                        // Skip whitespace/newlines
-                        while (ptr < end && std::isspace(static_cast<unsigned char>(*ptr))) ++ptr;
-                        // Read header line
-                        const char* line_start = ptr;
-                        while (ptr < end && *ptr != '\n' && *ptr != '\r') ++ptr;
-                        std::string line(line_start, ptr);
-
-                        std::istringstream ss(line);
+            switch (format) {
+                case VolumeFormat::VTK_ASCII: index_ascii(); break;
+                case VolumeFormat::VTK_BINARY: index_binary(); break;
+                case VolumeFormat::VTI: read_vti(); break;
+                case VolumeFormat::RAW: read_raw(); break;
+                // The cache table is the index, it was read when the cache was opened
+                case VolumeFormat::FIELD_CACHE: load_finished.store(true, std::memory_order_release); break;
+            }
+        });
+
+        return true;
+    }
+
+    bool LoadProxy::load_fields(const std::vector<std::string>& names) {
+        complete();
+
+        auto in_group = [this] (const std::string& group_name, const std::string& name) {
+            auto group = data->groups.find(group_name);
+            return group != data->groups.end() && std::ranges::find(group->second, name) != group->second.end();
+        };
+
+        // An extent holds either a whole group (interleaved in VTK files) or a single component (field caches),
+        // and either may be asked for by its group or component name
+        auto is_requested = [&names, &in_group] (const FieldExtent& extent) {
+            return std::ranges::any_of(names, [&extent, &in_group] (const std::string& name) {
+                return name == extent.name || in_group(extent.name, name) || in_group(name, extent.name);
+            });
+        };
+
+        pending_fields.clear();
+        for (size_t i = 0; i < field_index.size(); i++) {
+            if (!field_index[i].loaded && is_requested(field_index[i])) {
+                pending_fields.push_back(i);
+            }
+        }
+
+        if (pending_fields.empty()) {
+            return false;
+        }
+
+        // Progress is counted in values, add_field accounts for the extra components
+        num_bytes_read = 0;
+        total_bytes = pending_fields.size() * field_size;
+        read_failed = false;
+        stop_requested = false;
+        load_finished = false;
+        stats.start();
+
+        thread_dispatched.store(true, std::memory_order_release);
+        worker_thread = std::thread([this] {
+            switch (format) {
+                case VolumeFormat::VTK_ASCII: read_ascii(); break;
+                case VolumeFormat::VTK_BINARY: read_binary(); break;
+                case VolumeFormat::FIELD_CACHE: read_cache(); break;
+                default: break;
+            }
+        });
+
+        return true;
+    }
+
+    void LoadProxy::add_field_index(FieldExtent extent) {
+        // Fields are listed right away, their arrays stay empty until they are loaded
+        if (extent.comps == 1) {
+            data->scalars[extent.name];
+        }
+        else {
+            auto& group = data->groups[extent.name];
+            group.clear();
+            for (size_t comp = 0; comp < extent.comps; comp++) {
+                auto comp_name = component_name(extent.name, comp, extent.comps);
+                data->scalars[comp_name];
+                group.push_back(comp_name);
+            }
+        }
+
+        field_index.push_back(std::move(extent));
+    }
+
+    void LoadProxy::finish_field_load() {
+        PhaseTimer timer(stats, LoadPhase::FINALIZE);
+        for (auto idx : pending_fields) {
+            field_index[idx].loaded = true;
+        }
+        total_fields_read += pending_fields.size();
+        pending_fields.clear();
+
+        load_finished.store(true, std::memory_order_release);
+
+        // Once the whole file has been parsed it can be cached
+        if (format != VolumeFormat::FIELD_CACHE && std::ranges::all_of(field_index, &FieldExtent::loaded)) {
+            write_cache();
+        }
+    }
+
+    // Indexing pass: scan the whole file for field headers, recording where the values of each field
+    // start and end. Values are only counted (to validate the declared sizes), not parsed.
+    void LoadProxy::index_ascii() {
+        try {
+            file.clear();
+            file.seekg(0, std::ios::end);
+            size_t file_end = static_cast<size_t>(file.tellg());
+            size_t data_begin = static_cast<size_t>(file_offset);
+
+            num_bytes_read = 0;
+            total_bytes = file_end - data_begin;
+
+            size_t values_seen = 0;
+            size_t next_start = 0; // Index of the first value of the next field in the stream of all values
+            bool failed = false, found_end = false;
+            WorkerPool pool;
+
+            stream_ascii_lines(file, stats, data_begin, file_end, [&](const char* begin, const char* end, size_t pos) {
+                PhaseTimer timer(stats, LoadPhase::HEADER);
+                auto chunks = scan_ascii_block(pool, begin, end);
+                for (auto& chunk : chunks) {
+                    for (auto& header : chunk.headers) {
+                        size_t header_begin = pos + (header.begin - begin);
+                        size_t header_end = pos + (header.end - begin);
+                        size_t values_before = values_seen + header.values_before;
+
+                        // The first header past the declared field count starts the trailing metadata
+                        if (field_index.size() == total_fields) {
+                            if (values_before < next_start) {
+                                std::cerr << "Field " << field_index.back().name << " is truncated" << std::endl;
+                                failed = true;
+                                return false;
+                            }
+                            if (values_before > next_start) {
+                                std::cerr << "Field " << field_index.back().name << " has more values than declared" << std::endl;
+                                failed = true;
+                                return false;
+                            }
+                            field_index.back().end = header_begin;
+                            found_end = true;
+                            return false;
+                        }
+
+                        std::istringstream ss(std::string(header.begin, header.end));
+                        std::string cur_tag, type;
                         size_t comps = 0, count = 0;
-                        ss >> cur_tag >> comps >> count;
+                        ss >> cur_tag >> comps >> count >> type;
+
+                        if (values_before != next_start) {
+                            std::cerr << "Field data before " << cur_tag << " does not match its declared size" << std::endl;
+                            failed = true;
+                            return false;
+                        }
+
+                        if (comps == 0) {
+                            std::cerr << "Field " << cur_tag << " has no components" << std::endl;
+                            failed = true;
+                            return false;
+                        }
 
-                        if (comps != 1) {
-                            std::cerr << "Field " << cur_tag << " has more than one component. This is not supported right now..." << std::endl;
-                            read_failed = true;
-                            return;
+                        if (count != field_size) {
+                            std::cerr << "Field " << cur_tag << " size mismatch (" << count << " vs " << field_size << ")" << std::endl;
+                            failed = true;
+                            return false;
                         }
 
-                        if (count * comps != field_size) {
-                            std::cerr << "Field " << cur_tag << " size mismatch (" << count*comps << " vs " << field_size << ")" << std::endl;
-                            read_failed = true;
-                            return;
+                        if (!field_index.empty()) {
+                            field_index.back().end = header_begin;
                         }
+                        add_field_index({.name = cur_tag, .comps = comps, .type = type, .begin = std::min(header_end + 1, file_end), .end = file_end});
+                        next_start += count * comps;
+                    }
 
-                        data->scalars[cur_tag] = std::vector<float>(count * comps);
-                        ++ptr; // advance past newline if present
-                        cur_field_idx = 0;
+                    if (field_index.empty() && chunk.num_values) {
+                        std::cerr << "Field data found before any field header" << std::endl;
+                        failed = true;
+                        return false;
                     }
+                    values_seen += chunk.num_values;
+                }
+
+                num_bytes_read.fetch_add(end - begin, std::memory_order_relaxed);
+                return !stop_requested.load(std::memory_order_relaxed);
+            });
+
+            if (failed) {
+                read_failed = true;
+                return;
+            }
+
+            if (stop_requested.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            if (field_index.size() != total_fields || (!found_end && values_seen < next_start)) {
+                std::cerr << "Unexpected end of file (" << field_index.size() << " of " << total_fields << " fields found)" << std::endl;
+                read_failed = true;
+                return;
+            }
+
+            if (!found_end && values_seen > next_start) {
+                std::cerr << "Field " << field_index.back().name << " has more values than declared" << std::endl;
+                read_failed = true;
+                return;
+            }
+
+            load_finished.store(true, std::memory_order_release);
+        } catch (const std::exception& e) {
+            std::cerr << "Error while indexing VTK file: " << e.what() << std::endl;
+            read_failed = true;
+        }
+    }
+
+    void LoadProxy::read_ascii() {
+        try {
+            WorkerPool pool;
+            for (auto idx : pending_fields) {
+                auto& extent = field_index[idx];
+
+                AsciiParseState state;
+                state.fields.push_back({.start = 0, .size = field_size * extent.comps, .comps = extent.comps,
+                    .dests = add_field(extent.name, extent.comps)});
+
+                bool parsed = true;
+                stream_ascii_lines(file, stats, extent.begin, extent.end, [&](const char* begin, const char* end, size_t) {
+                    parsed = parse_ascii_block(*this, pool, state, begin, end);
+                    return parsed && !stop_requested.load(std::memory_order_relaxed);
+                });
+
+                if (!parsed) {
+                    read_failed = true;
+                    return;
+                }
+
+                if (stop_requested.load(std::memory_order_relaxed)) {
+                    return;
+                }
+
+                if (state.values_seen < state.fields[0].size) {
+                    std::cerr << "Field " << extent.name << " is truncated" << std::endl;
+                    read_failed = true;
+                    return;
+                }
+            }
+
+            finish_field_load();
+        } catch (const std::exception& e) {
+            std::cerr << "Error while loading VTK file: " << e.what() << std::endl;
+            read_failed = true;
+        }
+    }
+
+    // Indexing pass: binary payloads have a known size, so this only hops from header to header
+    void LoadProxy::index_binary() {
+        try {
+            PhaseTimer timer(stats, LoadPhase::HEADER);
+            file.close();
+
+            MappedFile mapping;
+            if (!mapping.open(filename)) {
+                read_failed = true;
+                return;
+            }
+
+            num_bytes_read = 0;
+            total_bytes = total_fields;
 
-                    auto& dest = data->scalars[cur_tag];
-
-                    while (ptr < end && cur_field_idx < field_size) {
-                        // Skip whitespace
-                        while (ptr < end && std::isspace(static_cast<unsigned char>(*ptr))) ++ptr;
-                        if (ptr >= end) break;
-                        float v;
-                        auto [next, ec] = std::from_chars(ptr, end, v);
-                        if (ec != std::errc()) break;
-                        dest[cur_field_idx++] = v;
-                        ptr = next;
-                        num_bytes_read.fetch_add(1, std::memory_order_relaxed);
+            const char* ptr = mapping.data() + static_cast<size_t>(file_offset);
+            const char* end = mapping.data() + mapping.size();
+
+            while (field_index.size() < total_fields) {
+                // Skip the newline that terminates the previous payload
+                while (ptr < end && std::isspace(static_cast<unsigned char>(*ptr))) ++ptr;
+                const char* line_start = ptr;
+                while (ptr < end && *ptr != '\n') ++ptr;
+                if (ptr >= end) {
+                    std::cerr << "Unexpected end of file while reading field header" << std::endl;
+                    read_failed = true;
+                    return;
+                }
+
+                std::istringstream ss(std::string(line_start, ptr));
+                std::string cur_tag, type;
+                size_t comps = 0, count = 0;
+                ss >> cur_tag >> comps >> count >> type;
+                ++ptr; // Payload starts right after the newline
+
+                if (comps == 0) {
+                    std::cerr << "Field " << cur_tag << " has no components" << std::endl;
+                    read_failed = true;
+                    return;
+                }
+
+                if (count != field_size) {
+                    std::cerr << "Field " << cur_tag << " size mismatch (" << count << " vs " << field_size << ")" << std::endl;
+                    read_failed = true;
+                    return;
+                }
+
+                BinaryConverter convert = nullptr;
+                FieldType storage;
+                auto type_size = get_binary_converter(type, convert, storage);
+                if (!type_size) {
+                    std::cerr << "Field " << cur_tag << " has unsupported data type " << type << std::endl;
+                    read_failed = true;
+                    return;
+                }
+
+                auto num_bytes = field_size * comps * type_size;
+                if (static_cast<size_t>(end - ptr) < num_bytes) {
+                    std::cerr << "Field " << cur_tag << " is truncated" << std::endl;
+                    read_failed = true;
+                    return;
+                }
+
+                size_t begin = ptr - mapping.data();
+                add_field_index({.name = cur_tag, .comps = comps, .type = type, .begin = begin, .end = begin + num_bytes});
+                ptr += num_bytes;
+                num_bytes_read.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            load_finished.store(true, std::memory_order_release);
+        } catch (const std::exception& e) {
+            std::cerr << "Error while indexing VTK file: " << e.what() << std::endl;
+            read_failed = true;
+        }
+    }
+
+    void LoadProxy::read_binary() {
+        try {
+            MappedFile mapping;
+            if (!mapping.open(filename)) {
+                read_failed = true;
+                return;
+            }
+
+            for (auto idx : pending_fields) {
+                auto& extent = field_index[idx];
+                auto comps = extent.comps;
+
+                BinaryConverter convert = nullptr;
+                FieldType storage;
+                auto type_size = get_binary_converter(extent.type, convert, storage);
+                if (!type_size || mapping.size() < extent.end) {
+                    std::cerr << "Field " << extent.name << " no longer matches the file" << std::endl;
+                    read_failed = true;
+                    return;
+                }
+
+                const char* ptr = mapping.data() + extent.begin;
+                auto dests = add_field(extent.name, comps, storage);
+                auto elem_size = get_field_type_size(storage);
+                std::vector<float> tuples;
+
+                for (size_t offset = 0; offset < field_size; offset += BINARY_CHUNK_VALUES) {
+                    auto chunk = std::min(BINARY_CHUNK_VALUES, field_size - offset);
+                    auto src = ptr + offset * comps * type_size;
+                    {
+                        PhaseTimer timer(stats, LoadPhase::READ);
+                        prefault(src, chunk * comps * type_size);
+                        stats.add_bytes(chunk * comps * type_size);
                     }
 
-                    if (cur_field_idx == field_size) {
-                        total_fields_read++;
-                        cur_field_idx = 0;
+                    PhaseTimer timer(stats, LoadPhase::PARSE);
+                    if (comps == 1) {
+                        convert(src, static_cast<char*>(dests[0]) + offset * elem_size, chunk);
                     }
+                    else {
+                        // Convert the interleaved tuples, then split them into the component arrays
+                        tuples.resize((chunk * comps * elem_size + sizeof(float) - 1) / sizeof(float));
+                        convert(src, tuples.data(), chunk * comps);
+                        split_components(tuples.data(), elem_size, offset, chunk, dests);
+                    }
+                    report_values(chunk * comps);
 
                     if (stop_requested.load(std::memory_order_relaxed)) {
                         return;
                     }
                 }
-            } catch (const std::exception& e) {
-                std::cerr << "Error while loading VTK file: " << e.what() << std::endl;
-                read_failed = true;
             }
-        });
 
-        return true;
+            finish_field_load();
+        } catch (const std::exception& e) {
+            std::cerr << "Error while loading VTK file: " << e.what() << std::endl;
+            read_failed = true;
+        }
+    }
+
+    void LoadProxy::report_values(size_t count) {
+        num_bytes_read.fetch_add(count, std::memory_order_relaxed);
+        stats.add_values(count);
     }
 
     void LoadProxy::cancel_io() {
@@ -269,11 +1122,20 @@ namespace MVF {
         thread_dispatched.store(false, std::memory_order_release);
     }
 
+    void LoadProxy::finish_cache() {
+        if (cache_thread.joinable()) {
+            cache_thread.join();
+        }
+    }
+
     void LoadProxy::reset() {
         if (worker_thread.joinable()) worker_thread.join();
+        stop_cache.store(true, std::memory_order_relaxed);
+        if (cache_thread.joinable()) cache_thread.join();
         thread_dispatched.store(false, std::memory_order_relaxed);
         num_bytes_read.store(0, std::memory_order_relaxed);
         total_fields_read = 0;
+        load_finished.store(false, std::memory_order_relaxed);
         read_failed = false;
         stop_requested.store(false, std::memory_order_relaxed);
     }
@@ -283,6 +1145,9 @@ namespace MVF {
         std::cout << "Destroyed proxy object: " << filename << std::endl;
 #endif
         if (worker_thread.joinable()) worker_thread.join();
+        // A cache still being written is given up rather than finished on the thread dropping the proxy
+        stop_cache.store(true, std::memory_order_relaxed);
+        if (cache_thread.joinable()) cache_thread.join();
     }
 }
 
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include "vtk.h"
+#include "field_cache.h"
+
+using namespace MVF;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// A 2x2x2 legacy VTK volume with one scalar and one 3 component array
+static void write_volume(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "# vtk DataFile Version 5.1\nvtk output\nASCII\nDATASET STRUCTURED_POINTS\n"
+        << "DIMENSIONS 2 2 2\nSPACING 1 1 1\nORIGIN 0 0 0\nPOINT_DATA 8\nFIELD FieldData 2\n"
+        << "density 1 8 float\n";
+    for (int i = 0; i < 8; i++) {
+        file << i << " ";
+    }
+    file << "\nvelocity 3 8 float\n";
+    for (int i = 0; i < 8; i++) {
+        file << i << " " << 10 + i << " " << 20 + i << " ";
+    }
+    file << "\n";
+}
+
+static std::unique_ptr<LoadProxy> open_loaded(const std::string& filename, const std::vector<std::string>& names) {
+    auto proxy = open_volume_async(filename);
+    proxy->load();
+    proxy->complete();
+    if (proxy->load_fields(names)) {
+        proxy->complete();
+    }
+    return proxy;
+}
+
+// Opening a cached volume lists one extent per component, asking for the group has to load all of them
+static void test_cached_group() {
+    auto dir = std::filesystem::temp_directory_path() / "mvf_field_cache_test";
+    std::filesystem::create_directories(dir);
+    auto filename = (dir / "grouped.vtk").string();
+    std::filesystem::remove(get_cache_filename(filename));
+    write_volume(filename);
+
+    // Parsing every field writes the cache once the proxy is done with it
+    open_loaded(filename, {"density", "velocity"})->finish_cache();
+    check(std::filesystem::exists(get_cache_filename(filename)), "cache is written after a full load");
+
+    auto proxy = open_loaded(filename, {"velocity"});
+    check(!proxy->read_failed, "cached volume loads");
+    check(proxy->format == VolumeFormat::FIELD_CACHE, "volume is opened from the cache");
+    auto& comps = proxy->data->groups["velocity"];
+    check(comps.size() == 3, "group lists its components");
+
+    for (size_t comp = 0; comp < comps.size(); comp++) {
+        auto& name = comps[comp];
+        auto& field = proxy->data->scalars[name];
+        check(field.size() == 8, name + " is loaded through its group");
+        for (size_t i = 0; i < field.size(); i++) {
+            check(field[i] == 10.0f * comp + i, name + " holds the source values");
+        }
+    }
+    check(proxy->data->scalars["density"].empty(), "fields outside the group stay unloaded");
+
+    std::filesystem::remove_all(dir);
+}
+
+int main() {
+    test_cached_group();
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "field_cache_test passed" << std::endl;
+    return 0;
+}